@@ -10,11 +10,13 @@
 #include "builder.h"
 #include "command_line.h"
 #include "graph.h"
+#include "omp.h"
 #include "platform_atomics.h"
 #include "pvector.h"
 #include "sliding_queue.h"
 #include "timer.h"
 #include "util.h"
+#include "work_queue.h"
 
 
 /*
@@ -31,7 +33,8 @@ subset of them. Additionally, the scores are normalized to the range [0,1].
 
 As an optimization to save memory, this implementation uses a Bitmap to hold
 succ (list of successors) found during the BFS phase that are used in the back-
-propagation phase.
+propagation phase. Back-propagation visits only the set bits in each vertex's
+range of edges, which lets it skip empty words when succ is sparse.
 
 [1] Ulrik Brandes. "A faster algorithm for betweenness centrality." Journal of
     Mathematical Sociology, 25(2):163–177, 2001.
@@ -50,7 +53,7 @@ typedef double CountT;
 
 void PBFS(const Graph &g, NodeID source, pvector<CountT> &path_counts,
     Bitmap &succ, vector<SlidingQueue<NodeID>::iterator> &depth_index,
-    SlidingQueue<NodeID> &queue) {
+    SlidingQueue<NodeID> &queue, WorkQueue &work) {
   pvector<NodeID> depths(g.num_nodes(), -1);
   depths[source] = 0;
   path_counts[source] = 1;
@@ -60,14 +63,21 @@ void PBFS(const Graph &g, NodeID source, pvector<CountT> &path_counts,
   const NodeID* g_out_start = g.out_neigh(0).begin();
   #pragma omp parallel
   {
+    #pragma omp single
+    work.Reset(omp_get_num_threads());
     NodeID depth = 0;
     QueueBuffer<NodeID> lqueue(queue);
     while (!queue.empty()) {
       depth++;
-      #pragma omp for schedule(dynamic, 64) nowait
-      for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
-        NodeID u = *q_iter;
-        for (NodeID &v : g.out_neigh(u)) {
+      const NodeID *frontier = queue.begin();
+      // work stealing, with edges of high-degree vertices split across threads
+      work.Run(omp_get_thread_num(), omp_get_num_threads(), queue.size(),
+               [&](int64_t i) { return g.out_degree(frontier[i]); },
+               [&](int64_t i, int64_t begin, int64_t end) {
+        NodeID u = frontier[i];
+        NodeID *neighs = g.out_neigh(u).begin();
+        for (int64_t e = begin; e < end; e++) {
+          NodeID &v = neighs[e];
           if ((depths[v] == -1) &&
               (compare_and_swap(depths[v], static_cast<NodeID>(-1), depth))) {
             lqueue.push_back(v);
@@ -78,7 +88,7 @@ void PBFS(const Graph &g, NodeID source, pvector<CountT> &path_counts,
             path_counts[v] += path_counts[u];
           }
         }
-      }
+      });
       lqueue.flush();
       #pragma omp barrier
       #pragma omp single
@@ -101,6 +111,7 @@ pvector<ScoreT> Brandes(const Graph &g, SourcePicker<Graph> &sp,
   Bitmap succ(g.num_edges_directed());
   vector<SlidingQueue<NodeID>::iterator> depth_index;
   SlidingQueue<NodeID> queue(g.num_nodes());
+  WorkQueue work(omp_get_max_threads());
   t.Stop();
   if (logging_enabled)
     PrintStep("a", t.Seconds());
@@ -114,7 +125,7 @@ pvector<ScoreT> Brandes(const Graph &g, SourcePicker<Graph> &sp,
     depth_index.resize(0);
     queue.reset();
     succ.reset();
-    PBFS(g, source, path_counts, succ, depth_index, queue);
+    PBFS(g, source, path_counts, succ, depth_index, queue, work);
     t.Stop();
     if (logging_enabled)
       PrintStep("b", t.Seconds());
@@ -125,10 +136,11 @@ pvector<ScoreT> Brandes(const Graph &g, SourcePicker<Graph> &sp,
       for (auto it = depth_index[d]; it < depth_index[d+1]; it++) {
         NodeID u = *it;
         ScoreT delta_u = 0;
-        for (NodeID &v : g.out_neigh(u)) {
-          if (succ.get_bit(&v - g_out_start)) {
-            delta_u += (path_counts[u] / path_counts[v]) * (1 + deltas[v]);
-          }
+        size_t edges_begin = g.out_neigh(u).begin() - g_out_start;
+        size_t edges_end = g.out_neigh(u).end() - g_out_start;
+        for (size_t e : succ.set_bits(edges_begin, edges_end)) {
+          NodeID v = g_out_start[e];
+          delta_u += (path_counts[u] / path_counts[v]) * (1 + deltas[v]);
         }
         deltas[u] = delta_u;
         scores[u] += delta_u;
@@ -161,16 +173,15 @@ void PrintTopScores(const Graph &g, const pvector<ScoreT> &scores) {
 }
 
 
-// Still uses Brandes algorithm, but has the following differences:
+// Reference scores for BCVerifier, still uses Brandes algorithm, but has the
+// following differences:
 // - serial (no need for atomics or dynamic scheduling)
 // - uses vector for BFS queue
 // - regenerates farthest to closest traversal order from depths
 // - regenerates successors from depths
-bool BCVerifier(const Graph &g, SourcePicker<Graph> &sp, NodeID num_iters,
-                const pvector<ScoreT> &scores_to_test) {
+pvector<ScoreT> SerialBrandes(const Graph &g, const vector<NodeID> &sources) {
   pvector<ScoreT> scores(g.num_nodes(), 0);
-  for (int iter=0; iter < num_iters; iter++) {
-    NodeID source = sp.PickNext();
+  for (NodeID source : sources) {
     // BFS phase, only records depth & path_counts
     pvector<int> depths(g.num_nodes(), -1);
     depths[source] = 0;
@@ -216,13 +227,24 @@ bool BCVerifier(const Graph &g, SourcePicker<Graph> &sp, NodeID num_iters,
   ScoreT biggest_score = *max_element(scores.begin(), scores.end());
   for (NodeID n : g.vertices())
     scores[n] = scores[n] / biggest_score;
-  // Compare scores
+  return scores;
+}
+
+
+// Compares against reference scores from SerialBrandes (computed once per
+// set of sources by the caller)
+bool BCVerifier(const Graph &g, const pvector<ScoreT> &scores,
+                const pvector<ScoreT> &scores_to_test) {
   bool all_ok = true;
-  for (NodeID n : g.vertices()) {
+  #pragma omp parallel for reduction(&& : all_ok)
+  for (NodeID n = 0; n < g.num_nodes(); n++) {
     ScoreT delta = abs(scores_to_test[n] - scores[n]);
     if (delta > std::numeric_limits<ScoreT>::epsilon()) {
-      cout << n << ": " << scores[n] << " != " << scores_to_test[n];
-      cout << "(" << delta << ")" << endl;
+      #pragma omp critical
+      {
+        cout << n << ": " << scores[n] << " != " << scores_to_test[n];
+        cout << "(" << delta << ")" << endl;
+      }
       all_ok = false;
     }
   }
@@ -238,14 +260,21 @@ int main(int argc, char* argv[]) {
     cout << "Warning: iterating from same source (-r & -i)" << endl;
   Builder b(cli);
   Graph g = b.MakeGraph();
-  SourcePicker<Graph> sp(g, cli.start_vertex());
+  SourcePicker<Graph> sp(g, "", cli.start_vertex());
   auto BCBound = [&sp, &cli] (const Graph &g) {
     return Brandes(g, sp, cli.num_iters(), cli.logging_en());
   };
-  SourcePicker<Graph> vsp(g, cli.start_vertex());
-  auto VerifierBound = [&vsp, &cli] (const Graph &g,
-                                     const pvector<ScoreT> &scores) {
-    return BCVerifier(g, vsp, cli.num_iters(), scores);
+  SourcePicker<Graph> vsp(g, "", cli.start_vertex());
+  OracleCache<vector<NodeID>, pvector<ScoreT>> oracle;
+  auto VerifierBound = [&vsp, &cli, &oracle] (const Graph &g,
+                                              const pvector<ScoreT> &scores) {
+    vector<NodeID> sources;
+    for (int iter=0; iter < cli.num_iters(); iter++)
+      sources.push_back(vsp.PickNext());
+    const pvector<ScoreT> &oracle_scores = oracle.Get(sources, [&] {
+      return SerialBrandes(g, sources);
+    });
+    return BCVerifier(g, oracle_scores, scores);
   };
   BenchmarkKernel(cli, g, BCBound, PrintTopScores, VerifierBound);
   return 0;
@@ -13,6 +13,7 @@
 
 #include "builder.h"
 #include "graph.h"
+#include "soa_graph.h"
 #include "timer.h"
 #include "util.h"
 #include "writer.h"
@@ -36,6 +37,7 @@ typedef NodeWeight<NodeID, WeightT> WNode;
 
 typedef CSRGraph<NodeID> Graph;
 typedef CSRGraph<NodeID, WNode> WGraph;
+typedef SoACSRGraph<NodeID, WeightT> SoAWGraph;
 
 typedef BuilderBase<NodeID, NodeID, WeightT> Builder;
 typedef BuilderBase<NodeID, WNode, WeightT> WeightedBuilder;
@@ -103,6 +105,30 @@ TopK(const std::vector<std::pair<KeyT, ValT>> &to_sort, size_t k) {
   return top_k;
 }
 
+// Holds the reference result a verifier compares against (e.g. serial
+// distances from a source) for the most recent key, so it is computed once
+// rather than on every trial
+template <typename KeyT_, typename ValueT_>
+class OracleCache {
+ public:
+  OracleCache() : valid_(false), key_() {}
+
+  template <typename ComputeFunc>
+  const ValueT_& Get(const KeyT_ &key, ComputeFunc compute) {
+    if (!valid_ || !(key == key_)) {
+      value_ = compute();
+      key_ = key;
+      valid_ = true;
+    }
+    return value_;
+  }
+
+ private:
+  bool valid_;
+  KeyT_ key_;
+  ValueT_ value_;
+};
+
 bool VerifyUnimplemented(...) {
   std::cout << "** verify unimplemented **" << std::endl;
   return false;
@@ -117,7 +143,7 @@ void BenchmarkKernel(const CLApp &cli, const GraphT_ &g, GraphFunc kernel,
   Timer trial_timer;
   for (int iter = 0; iter < cli.num_trials(); iter++) {
     trial_timer.Start();
-    auto result = kernel(g);
+    auto &&result = kernel(g);  // kernels may return buffers they reuse
     trial_timer.Stop();
     PrintTime("Trial Time", trial_timer.Seconds());
     total_seconds += trial_timer.Seconds();
@@ -1,18 +1,23 @@
 // Copyright (c) 2015, The Regents of the University of California (Regents)
 // See LICENSE.txt for license details
 
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <vector>
 
 #include "benchmark.h"
 #include "bitmap.h"
 #include "builder.h"
 #include "command_line.h"
+#include "frontier.h"
 #include "graph.h"
+#include "omp.h"
 #include "platform_atomics.h"
 #include "pvector.h"
 #include "sliding_queue.h"
 #include "timer.h"
+#include "work_queue.h"
 
 /*
 GAP Benchmark Suite
@@ -23,9 +28,14 @@ Will return parent array for a BFS traversal from a source vertex
 
 This BFS implementation makes use of the Direction-Optimizing approach [1].
 It uses the alpha and beta parameters to determine whether to switch search
-directions. For representing the frontier, it uses a SlidingQueue for the
-top-down approach and a Bitmap for the bottom-up approach. To reduce
-false-sharing for the top-down approach, thread-local QueueBuffer's are used.
+directions. The frontier (Frontier) is either a SlidingQueue (sparse) or a
+Bitmap (dense). The bottom-up approach needs a Bitmap, so the frontier is
+converted when switching to it, but the top-down approach can start from
+either: from a Bitmap it visits set bits a word at a time, skipping empty
+words, so switching back needs no conversion. Top-down steps always produce a
+SlidingQueue, and to reduce false-sharing they use thread-local QueueBuffer's.
+Threads split a sparse frontier with a work-stealing WorkQueue, which also
+splits the edges of high-degree vertices so one hub doesn't stall a step.
 
 To save time computing the number of edges exiting the frontier, this
 implementation precomputes the degrees in bulk at the beginning by storing
@@ -33,6 +43,19 @@ them in the parent array as negative numbers. Thus, the encoding of parent is:
   parent[x] < 0 implies x is unvisited and parent[x] = -out_degree(x)
   parent[x] >= 0 implies x been visited
 
+Alpha and beta can be set with -A and -B, or tuned for the graph with -A auto,
+which times short traversals with candidate values and keeps the fastest (only
+alpha if -B is also given). For a graph loaded from a file, the choice is saved
+next to it (<file>.dobfs) with the graph's size and topology checksum, so later
+runs on the same graph reuse it.
+
+Instead of parents, it can output depths (-o depths), kept in 8 or 16 bits per
+vertex when the traversal is shallow enough (it restarts with a wider type if
+not), or only which vertices were reached (-o visited), kept in a bitmap so
+bottom-up steps write no per-vertex array. The steps are shared by all three
+through small state classes that claim vertices. The frontier and outputs
+live in a BFSContext that is reused across trials and sources.
+
 [1] Scott Beamer, Krste Asanović, and David Patterson. "Direction-Optimizing
     Breadth-First Search." International Conference on High Performance
     Computing, Networking, Storage and Analysis (SC), Salt Lake City, Utah,
@@ -41,19 +64,106 @@ them in the parent array as negative numbers. Thus, the encoding of parent is:
 
 using namespace std;
 
-int64_t BUStep(const Graph &g, pvector<NodeID> &parent, Bitmap &front,
+// Per-vertex traversal state, so the same steps can produce parents, depths,
+// or only which vertices were reached. Each state provides:
+//  - Unvisited(u)
+//  - TryClaim(u, v): top-down, atomically marks v as reached from u, and
+//    returns v's out-degree (the edges it adds to check), or -1 if v was
+//    already reached
+//  - Claim(u, v): bottom-up, marks u as reached from v (only u's thread
+//    writes u, since BUStep gives each thread whole words of the frontier)
+//  - kMaxDepth: deepest level it can record
+
+// Parents, with unvisited vertices holding their negated degrees (see above)
+class ParentState {
+ public:
+  static const int64_t kMaxDepth = numeric_limits<int64_t>::max();
+
+  explicit ParentState(pvector<NodeID> &parent) : parent_(parent) {}
+
+  bool Unvisited(NodeID u) const { return parent_[u] < 0; }
+
+  int64_t TryClaim(NodeID u, NodeID v) {
+    NodeID curr_val = parent_[v];
+    if ((curr_val < 0) && compare_and_swap(parent_[v], curr_val, u))
+      return -curr_val;
+    return -1;
+  }
+
+  void Claim(NodeID u, NodeID v) { parent_[u] = v; }
+
+ private:
+  pvector<NodeID> &parent_;
+};
+
+// Depths, with the type's largest value marking unvisited vertices
+template <typename DepthT_>
+class DepthState {
+ public:
+  static const int64_t kMaxDepth = numeric_limits<DepthT_>::max() - 1;
+
+  static DepthT_ Unreached() { return numeric_limits<DepthT_>::max(); }
+
+  DepthState(const Graph &g, pvector<DepthT_> &depth) : g_(g), depth_(depth) {}
+
+  bool Unvisited(NodeID u) const { return depth_[u] == Unreached(); }
+
+  int64_t TryClaim(NodeID u, NodeID v) {
+    if ((depth_[v] == Unreached()) &&
+        compare_and_swap(depth_[v], Unreached(),
+                         static_cast<DepthT_>(depth_[u] + 1)))
+      return g_.out_degree(v);
+    return -1;
+  }
+
+  void Claim(NodeID u, NodeID v) { depth_[u] = depth_[v] + 1; }
+
+ private:
+  const Graph &g_;
+  pvector<DepthT_> &depth_;
+};
+
+// Only a bit per vertex, so bottom-up steps write no per-vertex array
+class VisitedState {
+ public:
+  static const int64_t kMaxDepth = numeric_limits<int64_t>::max();
+
+  VisitedState(const Graph &g, Bitmap &visited) : g_(g), visited_(visited) {}
+
+  bool Unvisited(NodeID u) const { return !visited_.get_bit(u); }
+
+  int64_t TryClaim(NodeID u, NodeID v) {
+    if (!visited_.get_bit(v) && visited_.try_set_bit_atomic(v))
+      return g_.out_degree(v);
+    return -1;
+  }
+
+  void Claim(NodeID u, NodeID v) { visited_.set_bit(u); }
+
+ private:
+  const Graph &g_;
+  Bitmap &visited_;
+};
+
+template <typename StateT_>
+int64_t BUStep(const Graph &g, StateT_ &state, const Bitmap &front,
                Bitmap &next) {
   int64_t awake_count = 0;
   next.reset();
-#pragma omp parallel for reduction(+ : awake_count) schedule(dynamic, 1024)
-  for (NodeID u = 0; u < g.num_nodes(); u++) {
-    if (parent[u] < 0) {
-      for (NodeID v : g.in_neigh(u)) {
-        if (front.get_bit(v)) {
-          parent[u] = v;
-          awake_count++;
-          next.set_bit(u);
-          break;
+  // parts have about equal in-edges and start on bitmap word boundaries, but
+  // searches stop early, so they are still taken dynamically
+  const VertexPartition<NodeID> &parts = g.in_parts();
+#pragma omp parallel for reduction(+ : awake_count) schedule(dynamic, 1)
+  for (int64_t p = 0; p < parts.size(); p++) {
+    for (NodeID u : parts[p]) {
+      if (state.Unvisited(u)) {
+        for (NodeID v : g.in_neigh(u)) {
+          if (front.get_bit(v)) {
+            state.Claim(u, v);
+            awake_count++;
+            next.set_bit(u);
+            break;
+          }
         }
       }
     }
@@ -61,113 +171,210 @@ int64_t BUStep(const Graph &g, pvector<NodeID> &parent, Bitmap &front,
   return awake_count;
 }
 
-int64_t TDStep(const Graph &g, pvector<NodeID> &parent,
-               SlidingQueue<NodeID> &queue) {
+// Claims u's unvisited out-neighbors among its edges [begin, end), returns
+// their degrees (edges to check)
+template <typename StateT_>
+inline int64_t TDVisit(const Graph &g, StateT_ &state, NodeID u, int64_t begin,
+                       int64_t end, QueueBuffer<NodeID> &lqueue) {
   int64_t scout_count = 0;
-#pragma omp parallel
-  {
-    QueueBuffer<NodeID> lqueue(queue);
-#pragma omp for reduction(+ : scout_count) nowait
-    for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
-      NodeID u = *q_iter;
-      for (NodeID v : g.out_neigh(u)) {
-        NodeID curr_val = parent[v];
-        if (curr_val < 0) {
-          if (compare_and_swap(parent[v], curr_val, u)) {
-            lqueue.push_back(v);
-            scout_count += -curr_val;
-          }
-        }
-      }
+  const NodeID *neighs = g.out_neigh(u).begin();
+  for (int64_t e = begin; e < end; e++) {
+    NodeID v = neighs[e];
+    int64_t v_degree = state.TryClaim(u, v);
+    if (v_degree >= 0) {
+      lqueue.push_back(v);
+      scout_count += v_degree;
     }
-    lqueue.flush();
   }
   return scout_count;
 }
 
-void QueueToBitmap(const SlidingQueue<NodeID> &queue, Bitmap &bm) {
-#pragma omp parallel for
-  for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
-    NodeID u = *q_iter;
-    bm.set_bit_atomic(u);
+// Top-down step from a sparse frontier, scheduled by work stealing that also
+// splits the edges of high-degree vertices across threads
+template <typename StateT_>
+int64_t TDStep(const Graph &g, StateT_ &state, SlidingQueue<NodeID> &queue,
+               WorkQueue &work) {
+  int64_t scout_count = 0;
+  const NodeID *frontier = queue.begin();
+#pragma omp parallel reduction(+ : scout_count)
+  {
+#pragma omp single
+    work.Reset(omp_get_num_threads());
+    QueueBuffer<NodeID> lqueue(queue);
+    work.Run(omp_get_thread_num(), omp_get_num_threads(), queue.size(),
+             [&](int64_t i) { return g.out_degree(frontier[i]); },
+             [&](int64_t i, int64_t begin, int64_t end) {
+               scout_count += TDVisit(g, state, frontier[i], begin, end,
+                                      lqueue);
+             });
+    lqueue.flush();
   }
+  return scout_count;
 }
 
-void BitmapToQueue(const Graph &g, const Bitmap &bm,
-                   SlidingQueue<NodeID> &queue) {
+// Top-down step from a dense frontier, visiting its set bits a word at a time
+// and using the bitmap's summary to skip runs of 64 empty words
+template <typename StateT_>
+int64_t TDStepDense(const Graph &g, StateT_ &state, const Bitmap &front,
+                    SlidingQueue<NodeID> &queue) {
+  int64_t scout_count = 0;
 #pragma omp parallel
   {
     QueueBuffer<NodeID> lqueue(queue);
-#pragma omp for nowait
-    for (NodeID n = 0; n < g.num_nodes(); n++)
-      if (bm.get_bit(n))
-        lqueue.push_back(n);
+#pragma omp for reduction(+ : scout_count) nowait schedule(dynamic, 1)
+    for (size_t s = 0; s < front.num_summary_words(); s++) {
+      for (uint64_t words = front.get_summary_word(s); words != 0;
+           words &= words - 1) {
+        size_t w = s * 64 + __builtin_ctzll(words);
+        for (uint64_t bits = front.get_word(w); bits != 0; bits &= bits - 1) {
+          NodeID u = w * 64 + __builtin_ctzll(bits);
+          scout_count += TDVisit(g, state, u, 0, g.out_degree(u), lqueue);
+        }
+      }
+    }
     lqueue.flush();
   }
-  queue.slide_window();
-}
-
-pvector<NodeID> InitParent(const Graph &g) {
-  pvector<NodeID> parent(g.num_nodes());
-#pragma omp parallel for
-  for (NodeID n = 0; n < g.num_nodes(); n++)
-    parent[n] = g.out_degree(n) != 0 ? -g.out_degree(n) : -1;
-  return parent;
+  return scout_count;
 }
 
-pvector<NodeID> DOBFS(const Graph &g, NodeID source,
-                      bool logging_enabled = false, int alpha = 15,
-                      int beta = 18) {
-  if (logging_enabled)
-    PrintStep("Source", static_cast<int64_t>(source));
+// Direction-optimizing traversal from source (already marked in state).
+// Returns false if it stopped early because the next level would be deeper
+// than state can record.
+template <typename StateT_>
+bool DOTraverse(const Graph &g, NodeID source, StateT_ &state,
+                Frontier<NodeID> &frontier, WorkQueue &work,
+                bool logging_enabled, int alpha, int beta) {
   Timer t;
-  t.Start();
-  pvector<NodeID> parent = InitParent(g);
-  t.Stop();
-  if (logging_enabled)
-    PrintStep("i", t.Seconds());
-  parent[source] = source;
-  SlidingQueue<NodeID> queue(g.num_nodes());
-  queue.push_back(source);
-  queue.slide_window();
-  Bitmap curr(g.num_nodes());
-  curr.reset();
-  Bitmap front(g.num_nodes());
-  front.reset();
+  frontier.Reset(source);
   int64_t edges_to_check = g.num_edges_directed();
   int64_t scout_count = g.out_degree(source);
-  while (!queue.empty()) {
+  int64_t depth = 0;
+  while (!frontier.empty()) {
     if (scout_count > edges_to_check / alpha) {
       int64_t awake_count, old_awake_count;
-      TIME_OP(t, QueueToBitmap(queue, front));
+      TIME_OP(t, frontier.ToDense());
       if (logging_enabled)
         PrintStep("e", t.Seconds());
-      awake_count = queue.size();
-      queue.slide_window();
+      awake_count = frontier.size();
       do {
+        if (depth++ == StateT_::kMaxDepth)
+          return false;
         t.Start();
         old_awake_count = awake_count;
-        awake_count = BUStep(g, parent, front, curr);
-        front.swap(curr);
+        awake_count = BUStep(g, state, frontier.bitmap(),
+                             frontier.next_bitmap());
+        frontier.AdvanceDense(awake_count);
         t.Stop();
         if (logging_enabled)
           PrintStep("bu", t.Seconds(), awake_count);
       } while ((awake_count >= old_awake_count) ||
                (awake_count > g.num_nodes() / beta));
-      TIME_OP(t, BitmapToQueue(g, front, queue));
-      if (logging_enabled)
-        PrintStep("c", t.Seconds());
       scout_count = 1;
     } else {
+      if (depth++ == StateT_::kMaxDepth)
+        return false;
       t.Start();
       edges_to_check -= scout_count;
-      scout_count = TDStep(g, parent, queue);
-      queue.slide_window();
+      if (frontier.dense())
+        scout_count = TDStepDense(g, state, frontier.bitmap(),
+                                  frontier.queue());
+      else
+        scout_count = TDStep(g, state, frontier.queue(), work);
+      frontier.AdvanceSparse();
       t.Stop();
       if (logging_enabled)
-        PrintStep("td", t.Seconds(), queue.size());
+        PrintStep("td", t.Seconds(), frontier.size());
     }
   }
+  return true;
+}
+
+void InitParent(const Graph &g, pvector<NodeID> &parent) {
+#pragma omp parallel for
+  for (NodeID n = 0; n < g.num_nodes(); n++)
+    parent[n] = g.out_degree(n) != 0 ? -g.out_degree(n) : -1;
+}
+
+// Depths from a BFS (-o depths), stored in 8 or 16 bits per vertex when the
+// source's eccentricity fits, and 32 otherwise
+class BFSDepths {
+ public:
+  explicit BFSDepths(size_t num_nodes)
+      : depth8(num_nodes), depth16(num_nodes), depth32(num_nodes),
+        bits_(8) {}
+
+  int bits() const { return bits_; }
+
+  void set_bits(int bits) { bits_ = bits; }
+
+  // Hops from the source, or -1 if unreached
+  int64_t operator[](NodeID n) const {
+    switch (bits_) {
+      case 8:
+        return depth8[n] == DepthState<uint8_t>::Unreached() ? -1 : depth8[n];
+      case 16:
+        return depth16[n] == DepthState<uint16_t>::Unreached() ? -1 :
+                                                                 depth16[n];
+      default:
+        return depth32[n] == DepthState<uint32_t>::Unreached() ? -1 :
+                                                                 depth32[n];
+    }
+  }
+
+  pvector<uint8_t> depth8;
+  pvector<uint16_t> depth16;
+  pvector<uint32_t> depth32;
+
+ private:
+  int bits_;
+};
+
+// Working buffers (frontier) and outputs for BFS traversals, allocated once
+// and reused across trials and sources. Outputs are only valid until the next
+// traversal. Unused outputs are never touched, so they cost no physical memory,
+// and a traversal only reinitializes (in parallel) the ones it uses, instead
+// of paying to allocate them and fault their pages in.
+class BFSContext {
+ public:
+  explicit BFSContext(size_t num_nodes)
+      : frontier_(num_nodes), work_(omp_get_max_threads()),
+        parent_(num_nodes), depths_(num_nodes), visited_(num_nodes),
+        min_depth_bits_(8) {}
+
+  Frontier<NodeID>& frontier() { return frontier_; }
+  WorkQueue& work() { return work_; }
+  pvector<NodeID>& parent() { return parent_; }
+  BFSDepths& depths() { return depths_; }
+  Bitmap& visited() { return visited_; }
+
+  // Narrowest depth type worth trying, widened once a traversal needed more
+  int& min_depth_bits() { return min_depth_bits_; }
+
+ private:
+  Frontier<NodeID> frontier_;
+  WorkQueue work_;
+  pvector<NodeID> parent_;
+  BFSDepths depths_;
+  Bitmap visited_;
+  int min_depth_bits_;
+};
+
+const pvector<NodeID>& DOBFS(const Graph &g, NodeID source, BFSContext &ctx,
+                             bool logging_enabled = false, int alpha = 15,
+                             int beta = 18) {
+  if (logging_enabled)
+    PrintStep("Source", static_cast<int64_t>(source));
+  Timer t;
+  t.Start();
+  pvector<NodeID> &parent = ctx.parent();
+  InitParent(g, parent);
+  t.Stop();
+  if (logging_enabled)
+    PrintStep("i", t.Seconds());
+  parent[source] = source;
+  ParentState state(parent);
+  DOTraverse(g, source, state, ctx.frontier(), ctx.work(), logging_enabled,
+             alpha, beta);
 #pragma omp parallel for
   for (NodeID n = 0; n < g.num_nodes(); n++)
     if (parent[n] < -1)
@@ -175,6 +382,146 @@ pvector<NodeID> DOBFS(const Graph &g, NodeID source,
   return parent;
 }
 
+template <typename DepthT_>
+bool DepthBFS(const Graph &g, NodeID source, pvector<DepthT_> &depth,
+              BFSContext &ctx, bool logging_enabled, int alpha, int beta) {
+  depth.fill(DepthState<DepthT_>::Unreached());
+  depth[source] = 0;
+  DepthState<DepthT_> state(g, depth);
+  return DOTraverse(g, source, state, ctx.frontier(), ctx.work(),
+                    logging_enabled, alpha, beta);
+}
+
+// Tries the narrowest depth type first (from ctx.min_depth_bits()), and widens
+// it when the traversal gets too deep, keeping the wider type for later calls
+const BFSDepths& DepthsBFS(const Graph &g, NodeID source, BFSContext &ctx,
+                           bool logging_enabled = false, int alpha = 15,
+                           int beta = 18) {
+  if (logging_enabled)
+    PrintStep("Source", static_cast<int64_t>(source));
+  BFSDepths &depths = ctx.depths();
+  int &min_bits = ctx.min_depth_bits();
+  if (min_bits <= 8) {
+    depths.set_bits(8);
+    if (DepthBFS(g, source, depths.depth8, ctx, logging_enabled, alpha, beta))
+      return depths;
+    min_bits = 16;
+  }
+  if (min_bits <= 16) {
+    depths.set_bits(16);
+    if (DepthBFS(g, source, depths.depth16, ctx, logging_enabled, alpha, beta))
+      return depths;
+    min_bits = 32;
+  }
+  depths.set_bits(32);
+  DepthBFS(g, source, depths.depth32, ctx, logging_enabled, alpha, beta);
+  return depths;
+}
+
+// Only which vertices are reachable from source (-o visited)
+const Bitmap& VisitedBFS(const Graph &g, NodeID source, BFSContext &ctx,
+                         bool logging_enabled = false, int alpha = 15,
+                         int beta = 18) {
+  if (logging_enabled)
+    PrintStep("Source", static_cast<int64_t>(source));
+  Bitmap &visited = ctx.visited();
+  visited.reset();
+  visited.set_bit(source);
+  VisitedState state(g, visited);
+  DOTraverse(g, source, state, ctx.frontier(), ctx.work(), logging_enabled,
+             alpha, beta);
+  return visited;
+}
+
+// Total time of traversals from sources with the given alpha and beta
+double CalibrationTime(const Graph &g, const vector<NodeID> &sources,
+                       BFSContext &ctx, int alpha, int beta) {
+  Timer t;
+  double total_seconds = 0;
+  for (NodeID source : sources) {
+    t.Start();
+    DOBFS(g, source, ctx, false, alpha, beta);
+    t.Stop();
+    total_seconds += t.Seconds();
+  }
+  return total_seconds;
+}
+
+// Picks alpha (with the given beta) and then (if tune_beta) beta from
+// candidates, by the time of traversals from a few random sources. Small
+// alphas favor bottom-up (social graphs), and large ones top-down
+// (high-diameter road networks). To not chase timing noise, a candidate must
+// beat the current choice by 5%.
+void TuneDirectionParams(const Graph &g, int &alpha, int &beta,
+                         bool tune_beta) {
+  const int kNumSources = 4;
+  const double kMinGain = 0.95;
+  const int kAlphas[] = {2, 4, 8, 15, 30, 60, 1 << 20};
+  const int kBetas[] = {6, 12, 18, 24, 48};
+  SourcePicker<Graph> sp(g);
+  vector<NodeID> sources;
+  for (int i = 0; i < kNumSources; i++)
+    sources.push_back(sp.PickNext());
+  BFSContext ctx(g.num_nodes());
+  CalibrationTime(g, sources, ctx, alpha, beta);  // warm up
+  double best_seconds = CalibrationTime(g, sources, ctx, alpha, beta);
+  for (int candidate : kAlphas) {
+    double seconds = CalibrationTime(g, sources, ctx, candidate, beta);
+    if (seconds < kMinGain * best_seconds) {
+      best_seconds = seconds;
+      alpha = candidate;
+    }
+  }
+  if (!tune_beta)
+    return;
+  for (int candidate : kBetas) {
+    double seconds = CalibrationTime(g, sources, ctx, alpha, candidate);
+    if (seconds < kMinGain * best_seconds) {
+      best_seconds = seconds;
+      beta = candidate;
+    }
+  }
+}
+
+// Alpha and beta for -A auto, from <file>.dobfs if it was saved for this graph
+// (same size and topology checksum) with a tuned beta or the beta given by -B,
+// or else by tuning (saving the result when the graph is a file)
+void PickDirectionParams(const CLBFS &cli, const Graph &g, int &alpha,
+                         int &beta) {
+  string params_filename = cli.filename() + ".dobfs";
+  uint64_t checksum = 0;
+  if (cli.filename() != "") {
+    checksum = g.TopologyChecksum();
+    ifstream params_file(params_filename);
+    int64_t num_nodes, num_edges;
+    uint64_t saved_checksum;
+    bool beta_tuned;
+    if ((params_file >> num_nodes >> num_edges >> saved_checksum >> alpha >>
+         beta >> beta_tuned) &&
+        (num_nodes == g.num_nodes()) && (num_edges == g.num_edges()) &&
+        (saved_checksum == checksum) && (alpha > 0) && (beta > 0) &&
+        (cli.beta_given() ? (beta == cli.beta()) : beta_tuned)) {
+      PrintLabel("Direction Params", "loaded");
+      return;
+    }
+  }
+  alpha = cli.alpha();
+  beta = cli.beta();
+  Timer t;
+  t.Start();
+  TuneDirectionParams(g, alpha, beta, !cli.beta_given());
+  t.Stop();
+  PrintTime("Tuning Time", t.Seconds());
+  if (cli.filename() != "") {
+    ofstream params_file(params_filename);
+    params_file << g.num_nodes() << " " << g.num_edges() << " " << checksum
+                << " " << alpha << " " << beta << " " << !cli.beta_given()
+                << endl;
+    if (!params_file)
+      cout << "Couldn't save direction params to " << params_filename << endl;
+  }
+}
+
 void PrintBFSStats(const Graph &g, const pvector<NodeID> &bfs_tree) {
   int64_t tree_size = 0;
   int64_t n_edges = 0;
@@ -188,12 +535,26 @@ void PrintBFSStats(const Graph &g, const pvector<NodeID> &bfs_tree) {
   cout << n_edges << " edges" << endl;
 }
 
-// BFS verifier does a serial BFS from same source and asserts:
-// - parent[source] = source
-// - parent[v] = u  =>  depth[v] = depth[u] + 1 (except for source)
-// - parent[v] = u  => there is edge from u to v
-// - all vertices reachable from source have a parent
-bool BFSVerifier(const Graph &g, NodeID source, const pvector<NodeID> &parent) {
+void PrintDepthStats(const Graph &g, const BFSDepths &depths) {
+  int64_t num_reached = 0;
+  int64_t max_depth = 0;
+  #pragma omp parallel for reduction(+ : num_reached) reduction(max : max_depth)
+  for (NodeID n = 0; n < g.num_nodes(); n++) {
+    if (depths[n] != -1) {
+      num_reached++;
+      max_depth = max(max_depth, depths[n]);
+    }
+  }
+  cout << "BFS reaches " << num_reached << " nodes with max depth "
+       << max_depth << " (" << depths.bits() << "-bit depths)" << endl;
+}
+
+void PrintVisitedStats(const Graph &g, const Bitmap &visited) {
+  cout << "BFS reaches " << visited.count() << " nodes" << endl;
+}
+
+// Depths from a serial BFS, the reference for BFSVerifier
+pvector<int> SerialBFSDepths(const Graph &g, NodeID source) {
   pvector<int> depth(g.num_nodes(), -1);
   depth[source] = 0;
   vector<NodeID> to_visit;
@@ -208,12 +569,27 @@ bool BFSVerifier(const Graph &g, NodeID source, const pvector<NodeID> &parent) {
       }
     }
   }
-  for (NodeID u : g.vertices()) {
+  return depth;
+}
+
+
+// BFS verifier uses depths from a serial BFS from same source (computed once
+// per source by the caller) and asserts (checking vertices in parallel):
+// - parent[source] = source
+// - parent[v] = u  =>  depth[v] = depth[u] + 1 (except for source)
+// - parent[v] = u  => there is edge from u to v
+// - all vertices reachable from source have a parent
+bool BFSVerifier(const Graph &g, NodeID source, const pvector<int> &depth,
+                 const pvector<NodeID> &parent) {
+  bool all_ok = true;
+  #pragma omp parallel for reduction(&& : all_ok) schedule(dynamic, 1024)
+  for (NodeID u = 0; u < g.num_nodes(); u++) {
     if ((depth[u] != -1) && (parent[u] != -1)) {
       if (u == source) {
         if (!((parent[u] == u) && (depth[u] == 0))) {
+          #pragma omp critical
           cout << "Source wrong" << endl;
-          return false;
+          all_ok = false;
         }
         continue;
       }
@@ -221,48 +597,123 @@ bool BFSVerifier(const Graph &g, NodeID source, const pvector<NodeID> &parent) {
       for (NodeID v : g.in_neigh(u)) {
         if (v == parent[u]) {
           if (depth[v] != depth[u] - 1) {
+            #pragma omp critical
             cout << "Wrong depths for " << u << " & " << v << endl;
-            return false;
+            all_ok = false;
           }
           parent_found = true;
           break;
         }
       }
       if (!parent_found) {
+        #pragma omp critical
         cout << "Couldn't find edge from " << parent[u] << " to " << u << endl;
-        return false;
+        all_ok = false;
       }
     } else if (depth[u] != parent[u]) {
+      #pragma omp critical
       cout << "Reachability mismatch" << endl;
-      return false;
+      all_ok = false;
     }
   }
-  return true;
+  return all_ok;
+}
+
+
+// Depths (-o depths) must match the serial BFS's exactly
+bool DepthVerifier(const Graph &g, const pvector<int> &depth,
+                   const BFSDepths &depths) {
+  bool all_ok = true;
+  #pragma omp parallel for reduction(&& : all_ok)
+  for (NodeID n = 0; n < g.num_nodes(); n++) {
+    if (depths[n] != depth[n]) {
+      #pragma omp critical
+      cout << "Wrong depth for " << n << ": " << depths[n] << " != "
+           << depth[n] << endl;
+      all_ok = false;
+    }
+  }
+  return all_ok;
+}
+
+// Visited vertices (-o visited) must be those the serial BFS reaches
+bool VisitedVerifier(const Graph &g, const pvector<int> &depth,
+                     const Bitmap &visited) {
+  bool all_ok = true;
+  #pragma omp parallel for reduction(&& : all_ok)
+  for (NodeID n = 0; n < g.num_nodes(); n++) {
+    if (visited.get_bit(n) != (depth[n] != -1)) {
+      #pragma omp critical
+      cout << "Reachability mismatch for " << n << endl;
+      all_ok = false;
+    }
+  }
+  return all_ok;
 }
 
 int main(int argc, char *argv[]) {
-  CLApp cli(argc, argv, "breadth-first search");
+  CLBFS cli(argc, argv, "breadth-first search");
   if (!cli.ParseArgs())
     return -1;
+  if ((cli.output() != "parents") && (cli.output() != "depths") &&
+      (cli.output() != "visited")) {
+    cout << "Unknown BFS output: " << cli.output() << endl;
+    exit(-10);
+  }
   Builder b(cli);
   Graph g = b.MakeGraph();
   g.PrintStats();
+  int alpha = cli.alpha();
+  int beta = cli.beta();
+  if (cli.tune_direction()) {
+    PickDirectionParams(cli, g, alpha, beta);
+    PrintStep("Alpha", static_cast<int64_t>(alpha));
+    PrintStep("Beta", static_cast<int64_t>(beta));
+  }
 
+  OracleCache<NodeID, pvector<int>> oracle;
   SourcePicker<Graph> sp(g, cli.sources_filename(), cli.start_vertex());
+  BFSContext ctx(g.num_nodes());
   for (auto i = 0; i < cli.num_sources(); i++) {
     auto source = sp.PickNext();
     std::cout << "Source: " << source << std::endl;
 
-    auto BFSBound = [&sp, &cli, source](const Graph &g) {
-      return DOBFS(g, source, cli.logging_en());
-    };
-
-    auto VerifierBound = [source](const Graph &g,
-                                  const pvector<NodeID> &parent) {
-      return BFSVerifier(g, source, parent);
+    auto OracleDepth = [source, &oracle](const Graph &g)
+                           -> const pvector<int>& {
+      return oracle.Get(source, [&] { return SerialBFSDepths(g, source); });
     };
 
-    BenchmarkKernel(cli, g, BFSBound, PrintBFSStats, VerifierBound);
+    if (cli.output() == "depths") {
+      auto BFSBound = [&cli, source, &ctx, alpha, beta](const Graph &g)
+                          -> const BFSDepths& {
+        return DepthsBFS(g, source, ctx, cli.logging_en(), alpha, beta);
+      };
+      auto VerifierBound = [&OracleDepth](const Graph &g,
+                                          const BFSDepths &depths) {
+        return DepthVerifier(g, OracleDepth(g), depths);
+      };
+      BenchmarkKernel(cli, g, BFSBound, PrintDepthStats, VerifierBound);
+    } else if (cli.output() == "visited") {
+      auto BFSBound = [&cli, source, &ctx, alpha, beta](const Graph &g)
+                          -> const Bitmap& {
+        return VisitedBFS(g, source, ctx, cli.logging_en(), alpha, beta);
+      };
+      auto VerifierBound = [&OracleDepth](const Graph &g,
+                                          const Bitmap &visited) {
+        return VisitedVerifier(g, OracleDepth(g), visited);
+      };
+      BenchmarkKernel(cli, g, BFSBound, PrintVisitedStats, VerifierBound);
+    } else {
+      auto BFSBound = [&cli, source, &ctx, alpha, beta](const Graph &g)
+                          -> const pvector<NodeID>& {
+        return DOBFS(g, source, ctx, cli.logging_en(), alpha, beta);
+      };
+      auto VerifierBound = [source, &OracleDepth](
+                               const Graph &g, const pvector<NodeID> &parent) {
+        return BFSVerifier(g, source, OracleDepth(g), parent);
+      };
+      BenchmarkKernel(cli, g, BFSBound, PrintBFSStats, VerifierBound);
+    }
   }
 
   return 0;
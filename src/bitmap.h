@@ -17,6 +17,12 @@ Author: Scott Beamer
 
 Parallel bitmap that is thread-safe
  - Can set bits in parallel (set_bit_atomic) unlike std::vector<bool>
+ - Exposes its words for fast iteration over set bits
+ - Keeps a summary with one bit per word (set if the word may be non-zero),
+   so iterating set bits (set_bits) skips runs of empty words 64 at a time
+ - set_bit_atomic keeps the summary current, while the cheaper set_bit needs
+   an update_summary() afterwards
+ - Reset, count, and bulk OR/AND run in parallel
 */
 
 
@@ -26,16 +32,38 @@ class Bitmap {
     uint64_t num_words = (size + kBitsPerWord - 1) / kBitsPerWord;
     start_ = new uint64_t[num_words];
     end_ = start_ + num_words;
+    uint64_t num_summary_words = (num_words + kBitsPerWord - 1) / kBitsPerWord;
+    summary_ = new uint64_t[num_summary_words];
+    summary_end_ = summary_ + num_summary_words;
   }
 
   ~Bitmap() {
     delete[] start_;
+    delete[] summary_;
+  }
+
+  Bitmap(const Bitmap &other) = delete;
+  Bitmap& operator=(const Bitmap &other) = delete;
+
+  Bitmap(Bitmap &&other)
+      : start_(other.start_), end_(other.end_), summary_(other.summary_),
+        summary_end_(other.summary_end_) {
+    other.start_ = nullptr;
+    other.end_ = nullptr;
+    other.summary_ = nullptr;
+    other.summary_end_ = nullptr;
   }
 
   void reset() {
-    std::fill(start_, end_, 0);
+    const size_t kBlockWords = 1 << 12;
+    #pragma omp parallel for
+    for (size_t w = 0; w < num_words(); w += kBlockWords)
+      std::fill(start_ + w, start_ + std::min(w + kBlockWords, num_words()), 0);
+    std::fill(summary_, summary_end_, 0);
   }
 
+  // Leaves the summary stale (so hot loops don't contend on it), so call
+  // update_summary() before iterating over bits set this way
   void set_bit(size_t pos) {
     start_[word_offset(pos)] |= ((uint64_t) 1l << bit_offset(pos));
   }
@@ -46,24 +74,175 @@ class Bitmap {
       old_val = start_[word_offset(pos)];
       new_val = old_val | ((uint64_t) 1l << bit_offset(pos));
     } while (!compare_and_swap(start_[word_offset(pos)], old_val, new_val));
+    if (old_val == 0)
+      mark_word(word_offset(pos));
+  }
+
+  // Sets the bit and returns whether this call changed it (so one of the
+  // threads racing to set it wins)
+  bool try_set_bit_atomic(size_t pos) {
+    uint64_t old_val, new_val;
+    do {
+      old_val = start_[word_offset(pos)];
+      new_val = old_val | ((uint64_t) 1l << bit_offset(pos));
+      if (old_val == new_val)
+        return false;
+    } while (!compare_and_swap(start_[word_offset(pos)], old_val, new_val));
+    if (old_val == 0)
+      mark_word(word_offset(pos));
+    return true;
   }
 
   bool get_bit(size_t pos) const {
     return (start_[word_offset(pos)] >> bit_offset(pos)) & 1l;
   }
 
+  // Raw 64-bit words (bit i of word w is position w*64 + i), so callers can
+  // skip empty words and find set bits with __builtin_ctzll
+  size_t num_words() const { return end_ - start_; }
+
+  uint64_t get_word(size_t w) const { return start_[w]; }
+
+  // Whether words [64*s, 64*s + 64) may have set bits (bit i for word 64*s+i)
+  uint64_t get_summary_word(size_t s) const { return summary_[s]; }
+
+  size_t num_summary_words() const { return summary_end_ - summary_; }
+
+  // Rebuilds the summary from the words, after set_bit() calls
+  void update_summary() {
+    #pragma omp parallel for
+    for (size_t s = 0; s < num_summary_words(); s++) {
+      uint64_t summary_bits = 0;
+      size_t w_end = std::min((s + 1) * kBitsPerWord, num_words());
+      for (size_t w = s * kBitsPerWord; w < w_end; w++)
+        summary_bits |= (uint64_t) (start_[w] != 0) << bit_offset(w);
+      summary_[s] = summary_bits;
+    }
+  }
+
+  // Number of set bits
+  int64_t count() const {
+    int64_t total = 0;
+    #pragma omp parallel for reduction(+ : total)
+    for (const uint64_t *w = start_; w < end_; w++)
+      total += __builtin_popcountll(*w);
+    return total;
+  }
+
+  // Smallest set position in [pos, end), or end if there is none
+  size_t next_set_bit(size_t pos, size_t end) const {
+    if (pos >= end)
+      return end;
+    size_t w = word_offset(pos);
+    uint64_t bits = start_[w] & (~(uint64_t) 0 << bit_offset(pos));
+    while (bits == 0) {
+      w++;
+      uint64_t summary_bits = 0;
+      while ((w < num_words()) && (w * kBitsPerWord < end) &&
+             ((summary_bits = summary_[w / kBitsPerWord] >>
+                              bit_offset(w)) == 0))
+        w = (w / kBitsPerWord + 1) * kBitsPerWord;
+      if ((w >= num_words()) || (w * kBitsPerWord >= end))
+        return end;
+      w += __builtin_ctzll(summary_bits);
+      if (w * kBitsPerWord >= end)
+        return end;
+      bits = start_[w];
+    }
+    return std::min(w * kBitsPerWord + __builtin_ctzll(bits), end);
+  }
+
+  class SetBitIterator {
+   public:
+    SetBitIterator(const Bitmap &bm, size_t pos, size_t end)
+        : bm_(bm), pos_(bm.next_set_bit(pos, end)), end_(end) {}
+
+    size_t operator*() const { return pos_; }
+
+    SetBitIterator& operator++() {
+      pos_ = bm_.next_set_bit(pos_ + 1, end_);
+      return *this;
+    }
+
+    bool operator!=(const SetBitIterator &other) const {
+      return pos_ != other.pos_;
+    }
+
+   private:
+    const Bitmap &bm_;
+    size_t pos_;
+    size_t end_;
+  };
+
+  class SetBitRange {
+   public:
+    SetBitRange(const Bitmap &bm, size_t begin, size_t end)
+        : bm_(bm), begin_(begin), end_(end) {}
+    SetBitIterator begin() const { return SetBitIterator(bm_, begin_, end_); }
+    SetBitIterator end() const { return SetBitIterator(bm_, end_, end_); }
+
+   private:
+    const Bitmap &bm_;
+    size_t begin_;
+    size_t end_;
+  };
+
+  // Positions of set bits in [begin, end), in increasing order
+  SetBitRange set_bits(size_t begin, size_t end) const {
+    return SetBitRange(*this, begin, end);
+  }
+
+  // this |= other (same size)
+  void or_with(const Bitmap &other) {
+    #pragma omp parallel for
+    for (size_t w = 0; w < num_words(); w++)
+      start_[w] |= other.start_[w];
+    #pragma omp parallel for
+    for (size_t s = 0; s < num_summary_words(); s++)
+      summary_[s] |= other.summary_[s];
+  }
+
+  // this &= other (same size), summary recomputed for the words it clears
+  void and_with(const Bitmap &other) {
+    #pragma omp parallel for
+    for (size_t s = 0; s < num_summary_words(); s++) {
+      uint64_t summary_bits = 0;
+      size_t w_end = std::min((s + 1) * kBitsPerWord, num_words());
+      for (size_t w = s * kBitsPerWord; w < w_end; w++) {
+        start_[w] &= other.start_[w];
+        summary_bits |= (uint64_t) (start_[w] != 0) << bit_offset(w);
+      }
+      summary_[s] = summary_bits;
+    }
+  }
+
   void swap(Bitmap &other) {
     std::swap(start_, other.start_);
     std::swap(end_, other.end_);
+    std::swap(summary_, other.summary_);
+    std::swap(summary_end_, other.summary_end_);
   }
 
  private:
   uint64_t *start_;
   uint64_t *end_;
+  uint64_t *summary_;
+  uint64_t *summary_end_;
 
   static const uint64_t kBitsPerWord = 64;
   static uint64_t word_offset(size_t n) { return n / kBitsPerWord; }
   static uint64_t bit_offset(size_t n) { return n & (kBitsPerWord - 1); }
+
+  // Sets word w's summary bit (atomically, since neighboring words can be
+  // written by other threads)
+  void mark_word(size_t w) {
+    uint64_t &summary_word = summary_[word_offset(w)];
+    uint64_t mask = (uint64_t) 1l << bit_offset(w);
+    uint64_t old_val = summary_word;
+    while (!(old_val & mask) &&
+           !compare_and_swap(summary_word, old_val, old_val | mask))
+      old_val = summary_word;
+  }
 };
 
 #endif  // BITMAP_H_
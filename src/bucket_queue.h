@@ -0,0 +1,299 @@
+// Copyright (c) 2015, The Regents of the University of California (Regents)
+// See LICENSE.txt for license details
+
+#ifndef BUCKET_QUEUE_H_
+#define BUCKET_QUEUE_H_
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <vector>
+
+#include "platform_atomics.h"
+
+
+/*
+GAP Benchmark Suite
+Class:  BucketQueue
+
+Concurrent priority buckets for relaxed-order worklists (in the style of
+Galois' OBIM), with no barriers between priorities
+ - Items are pushed into thread-private chunks (one per priority), and a
+   chunk is published to its bucket's shared stack once full or once its
+   owner runs out of work at its current priority
+ - Threads pop whole chunks, so any thread can take (steal) any published
+   chunk, and a thread first takes its own chunk at its current priority
+ - Each thread moves on to the lowest non-empty bucket independently, so
+   items may run out of priority order and the caller must tolerate that
+ - Buckets are a ring over a window of kWindow priorities starting at the
+   lowest non-empty one, so memory doesn't grow with the priorities used.
+   Chunks past the window wait on an overflow stack until the window is
+   empty, then move into the window starting at the lowest of them. Each
+   chunk remembers its priority, so a chunk in a bucket shared by priorities
+   a window apart is still returned with its own.
+ - Bucket stacks are lock-free: a chunk popped from a bucket during a run is
+   only reused in a later run, so pops can't suffer from ABA (the overflow
+   stack is only ever emptied as a whole)
+ - Idle threads wait on a count of published chunks instead of scanning
+ - Next() returns false only once every thread is idle and no chunks remain
+*/
+
+
+template <typename T_>
+class BucketQueue {
+  static const size_t kChunkSize = 64;
+  static const size_t kWindow = 1 << 16;
+  static const size_t kOpenSlots = 1 << 8;
+
+ public:
+  class Chunk {
+   public:
+    const T_* begin() const { return items_; }
+    const T_* end() const { return items_ + size_; }
+
+   private:
+    friend class BucketQueue;
+    Chunk *next_;
+    size_t priority_;
+    size_t size_;
+    T_ items_[kChunkSize];
+  };
+
+  // Priorities above max_priority are lowered to it
+  BucketQueue(size_t max_priority, int num_threads)
+      : max_priority_(max_priority), heads_(kWindow, nullptr),
+        overflow_(nullptr), threads_(num_threads), lowest_(0), pending_(0),
+        active_(0) {}
+
+  ~BucketQueue() {
+    for (ThreadState &ts : threads_) {
+      for (Chunk *chunk : ts.free)
+        delete chunk;
+      for (Chunk *chunk : ts.retired)
+        delete chunk;
+    }
+  }
+
+  BucketQueue(const BucketQueue &other) = delete;
+  BucketQueue& operator=(const BucketQueue &other) = delete;
+
+  size_t max_priority() const { return max_priority_; }
+
+  // Called by one thread before the threads of a run start calling Next()
+  void Start(int num_threads) {
+    lowest_ = 0;
+    pending_ = 0;
+    active_ = num_threads;
+  }
+
+  void Push(int thread, size_t priority, T_ item) {
+    ThreadState &ts = threads_[thread];
+    priority = std::min(priority, max_priority_);
+    Chunk *&chunk = ts.open[priority % kOpenSlots];
+    if ((chunk != nullptr) && (chunk->priority_ != priority)) {
+      Publish(chunk);  // slot was holding another priority
+      chunk = nullptr;
+    }
+    if (chunk == nullptr) {
+      chunk = NewChunk(ts, priority);
+      ts.open_lo = std::min(ts.open_lo, priority);
+      ts.open_hi = std::max(ts.open_hi, priority + 1);
+    }
+    chunk->items_[chunk->size_++] = item;
+    if (chunk->size_ == kChunkSize) {
+      Publish(chunk);
+      chunk = nullptr;
+    }
+  }
+
+  // Gets the next chunk to process and its priority, retiring the previous
+  // one, and returns false once all work is done (all threads must call it
+  // until then)
+  bool Next(int thread, size_t &priority, const Chunk *&chunk) {
+    ThreadState &ts = threads_[thread];
+    if (ts.last != nullptr)
+      ts.retired.push_back(ts.last);
+    ts.last = TakeOpen(ts, priority);
+    if (ts.last == nullptr)
+      ts.last = PopShared(priority);
+    if (ts.last == nullptr) {
+      FlushOpen(ts);
+      while (ts.last == nullptr) {
+        if (FindShared(priority)) {
+          ts.last = PopShared(priority);
+          continue;
+        }
+        // idle until others publish more work or everyone is idle
+        fetch_and_add(active_, -1);
+        while (!FindShared(priority)) {
+          if (Load(active_) == 0) {
+            ts.free.insert(ts.free.end(), ts.retired.begin(),
+                           ts.retired.end());
+            ts.retired.clear();
+            return false;
+          }
+        }
+        fetch_and_add(active_, 1);
+      }
+    }
+    priority = ts.last->priority_;
+    chunk = ts.last;
+    return true;
+  }
+
+ private:
+  struct ThreadState {
+    ThreadState()
+        : open(kOpenSlots, nullptr), open_lo(SIZE_MAX), open_hi(0),
+          last(nullptr) {}
+    std::vector<Chunk*> open;   // private chunks by priority % kOpenSlots
+    size_t open_lo, open_hi;    // range of priorities with private chunks
+    std::vector<Chunk*> free;
+    std::vector<Chunk*> retired;
+    Chunk *last;
+    char padding[64];           // avoid false sharing with neighbors
+  };
+
+  template <typename U_>
+  static U_ Load(U_ &x) {
+    return *const_cast<volatile U_*>(&x);
+  }
+
+  Chunk* NewChunk(ThreadState &ts, size_t priority) {
+    Chunk *chunk;
+    if (ts.free.empty()) {
+      chunk = new Chunk;
+    } else {
+      chunk = ts.free.back();
+      ts.free.pop_back();
+    }
+    chunk->priority_ = priority;
+    chunk->size_ = 0;
+    return chunk;
+  }
+
+  Chunk* TakeOpen(ThreadState &ts, size_t priority) {
+    Chunk *&slot = ts.open[priority % kOpenSlots];
+    if ((slot == nullptr) || (slot->priority_ != priority))
+      return nullptr;
+    Chunk *chunk = slot;
+    slot = nullptr;
+    return chunk;
+  }
+
+  void FlushOpen(ThreadState &ts) {
+    size_t end = std::min(ts.open_hi, ts.open_lo + kOpenSlots);
+    for (size_t p = ts.open_lo; p < end; p++) {
+      Chunk *&slot = ts.open[p % kOpenSlots];
+      if (slot != nullptr) {
+        Publish(slot);
+        slot = nullptr;
+      }
+    }
+    ts.open_lo = SIZE_MAX;
+    ts.open_hi = 0;
+  }
+
+  static void PushChunk(Chunk *&head, Chunk *chunk) {
+    do {
+      chunk->next_ = Load(head);
+    } while (!compare_and_swap(head, chunk->next_, chunk));
+  }
+
+  // Pushes to the chunk's bucket (lowering lowest_ to it if needed), or to
+  // the overflow stack if it is past the window
+  void Place(Chunk *chunk) {
+    size_t priority = chunk->priority_;
+    size_t lowest = Load(lowest_);
+    if (priority >= lowest + kWindow) {
+      PushChunk(overflow_, chunk);
+      return;
+    }
+    PushChunk(heads_[priority % kWindow], chunk);
+    while ((priority < lowest) && !compare_and_swap(lowest_, lowest, priority))
+      lowest = Load(lowest_);
+  }
+
+  void Publish(Chunk *chunk) {
+    fetch_and_add(pending_, 1);  // before it can be popped
+    Place(chunk);
+  }
+
+  Chunk* PopShared(size_t priority) {
+    Chunk *&head = heads_[priority % kWindow];
+    Chunk *chunk = Load(head);
+    while ((chunk != nullptr) && !compare_and_swap(head, chunk, chunk->next_))
+      chunk = Load(head);
+    if (chunk != nullptr)
+      fetch_and_add(pending_, -1);
+    return chunk;
+  }
+
+  // Finds the lowest non-empty bucket, and advances lowest_ past empty ones.
+  // Publishing lowers lowest_ after pushing, so rechecking the skipped
+  // buckets after advancing catches any chunk published to them meanwhile.
+  // Scans the whole ring (only when chunks are pending), so a chunk below
+  // lowest_ is found even if the window moved up past it. If the ring is
+  // empty, moves the overflow chunks into the window.
+  bool FindShared(size_t &priority) {
+    if (Load(pending_) == 0)
+      return false;
+    size_t lowest = Load(lowest_);
+    size_t p = lowest;
+    while ((p < lowest + kWindow) && (Load(heads_[p % kWindow]) == nullptr))
+      p++;
+    if (p == lowest + kWindow)
+      return MoveOverflow() && FindShared(priority);
+    if ((p > lowest) && compare_and_swap(lowest_, lowest, p)) {
+      for (size_t q = lowest; q < p; q++) {
+        if (Load(heads_[q % kWindow]) != nullptr) {
+          size_t curr = Load(lowest_);
+          while ((q < curr) && !compare_and_swap(lowest_, curr, q))
+            curr = Load(lowest_);
+          break;
+        }
+      }
+    }
+    priority = p;
+    return true;
+  }
+
+  // Takes the whole overflow stack and places its chunks again after moving
+  // the window up to the lowest of them. Counts as active meanwhile, so no
+  // thread can finish while the chunks are only held here.
+  bool MoveOverflow() {
+    if (Load(overflow_) == nullptr)
+      return false;
+    fetch_and_add(active_, 1);
+    Chunk *chunks = Load(overflow_);
+    while ((chunks != nullptr) &&
+           !compare_and_swap(overflow_, chunks, static_cast<Chunk*>(nullptr)))
+      chunks = Load(overflow_);
+    bool moved = chunks != nullptr;
+    if (moved) {
+      size_t min_priority = SIZE_MAX;
+      for (Chunk *c = chunks; c != nullptr; c = c->next_)
+        min_priority = std::min(min_priority, c->priority_);
+      size_t lowest = Load(lowest_);
+      if (min_priority > lowest)
+        compare_and_swap(lowest_, lowest, min_priority);
+      while (chunks != nullptr) {
+        Chunk *next = chunks->next_;
+        Place(chunks);
+        chunks = next;
+      }
+    }
+    fetch_and_add(active_, -1);
+    return moved;
+  }
+
+  const size_t max_priority_;
+  std::vector<Chunk*> heads_;
+  Chunk *overflow_;
+  std::vector<ThreadState> threads_;
+  size_t lowest_;
+  int64_t pending_;
+  int64_t active_;
+};
+
+#endif  // BUCKET_QUEUE_H_
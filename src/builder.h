@@ -28,7 +28,10 @@ Author: Scott Beamer
 Given arguments from the command line (cli), returns a built graph
  - MakeGraph() will parse cli and obtain edgelist to call
    MakeGraphFromEL(edgelist) to perform the actual graph construction
+ - if requested (-W), MakeGraph() then overwrites weights (AssignWeights)
  - edgelist can be from file (Reader) or synthetically generated (Generator)
+ - with -m, synthetic graphs are built without an edgelist when the generator
+   can stream its edges (MakeGraphFromGenerator)
  - Common case: BuilderBase typedef'd (w/ params) to be Builder (benchmark.h)
 */
 
@@ -341,7 +344,193 @@ public:
                                                 inv_index, inv_neighs);
   }
 
+  /*
+  Generator visitor for building without an edgelist (propagation blocking)
+    - For each edge (u,v) other than a self-loop, calls apply(u, v) and
+      apply(v, u), and records the largest ID seen in max_seen
+    - Each thread's copy buffers these updates by range of vertices, and
+      applies a range's updates together once its buffer fills (or when the
+      copy is destroyed), so each batch of scattered writes stays within a
+      small part of the arrays apply touches instead of missing in cache
+    - apply must be safe to call in parallel (copies flush concurrently)
+  */
+  template <typename ApplyT_>
+  class BinnedVisitor {
+    static const int kMinBinBits = 12;
+    static const int64_t kMaxBins = 1024;
+    static const int kBinCapacity = 256;
+    typedef std::pair<NodeID_, DestID_> Update;
+
+   public:
+    BinnedVisitor(BuilderBase *builder, int64_t num_nodes, ApplyT_ apply,
+                  NodeID_ *max_seen)
+        : builder_(builder), apply_(apply), shared_max_(max_seen),
+          local_max_(0), bin_bits_(kMinBinBits) {
+      while ((num_nodes >> bin_bits_) >= kMaxBins)
+        bin_bits_++;
+      num_bins_ = (num_nodes >> bin_bits_) + 1;
+    }
+
+    // Copies start with empty buffers (allocated on first use)
+    BinnedVisitor(const BinnedVisitor &other)
+        : builder_(other.builder_), apply_(other.apply_),
+          shared_max_(other.shared_max_), local_max_(0),
+          bin_bits_(other.bin_bits_), num_bins_(other.num_bins_) {}
+
+    BinnedVisitor& operator=(const BinnedVisitor &other) = delete;
+
+    ~BinnedVisitor() {
+      for (int64_t b = 0; b < static_cast<int64_t>(fills_.size()); b++)
+        Flush(b);
+      NodeID_ curr_max = *shared_max_;
+      while ((local_max_ > curr_max) &&
+             !compare_and_swap(*shared_max_, curr_max, local_max_))
+        curr_max = *shared_max_;
+    }
+
+    void operator()(int64_t e, Edge edge) {
+      NodeID_ v = static_cast<NodeID_>(edge.v);
+      local_max_ = std::max(local_max_, std::max(edge.u, v));
+      if (edge.u != v) {
+        Add(edge.u, edge.v);
+        Add(v, builder_->GetSource(edge));
+      }
+    }
+
+   private:
+    void Add(NodeID_ u, DestID_ val) {
+      if (fills_.empty()) {
+        buffer_.resize(num_bins_ * kBinCapacity);
+        fills_.assign(num_bins_, 0);
+      }
+      int64_t b = u >> bin_bits_;
+      buffer_[b * kBinCapacity + fills_[b]] = Update(u, val);
+      if (++fills_[b] == kBinCapacity)
+        Flush(b);
+    }
+
+    void Flush(int64_t b) {
+      for (int i = 0; i < fills_[b]; i++) {
+        const Update &update = buffer_[b * kBinCapacity + i];
+        apply_(update.first, update.second);
+      }
+      fills_[b] = 0;
+    }
+
+    BuilderBase *builder_;
+    ApplyT_ apply_;
+    NodeID_ *shared_max_;
+    NodeID_ local_max_;
+    int bin_bits_;
+    int64_t num_bins_;
+    std::vector<Update> buffer_;
+    std::vector<int> fills_;
+  };
+
+  template <typename ApplyT_>
+  BinnedVisitor<ApplyT_> MakeBinnedVisitor(int64_t num_nodes, ApplyT_ apply,
+                                           NodeID_ *max_seen) {
+    return BinnedVisitor<ApplyT_>(this, num_nodes, apply, max_seen);
+  }
+
+  /*
+  Building Straight from Generator (-m with synthetic graph)
+    - Generate edges once to count degrees (skipping self-loops) and find the
+      largest ID, so the vertex count matches FindMaxNodeID on the edgelist
+    - Generate them again to fill neighborhoods (generation is deterministic)
+    - Both passes batch their scattered writes with a BinnedVisitor
+    - Squish each neighborhood in place, then compact them to the front
+      (space of removed duplicates stays allocated until graph is freed)
+    - Avoids ever holding the edgelist, so peak is roughly the unsquished CSR
+  */
+  CSRGraph<NodeID_, DestID_, invert>
+  MakeGraphFromGenerator(Generator<NodeID_, DestID_> &gen,
+                         const std::string &spec) {
+    Timer t;
+    t.Start();
+    const int64_t max_nodes = 1l << cli_.scale();
+    pvector<NodeID_> degrees(max_nodes, 0);
+    NodeID_ max_seen = 0;
+    gen.VisitEdges(spec, MakeBinnedVisitor(max_nodes,
+        [&degrees] (NodeID_ u, DestID_ v) { fetch_and_add(degrees[u], 1); },
+        &max_seen));
+    num_nodes_ = max_seen + 1;
+    degrees.resize(num_nodes_);
+    pvector<SGOffset> offsets = ParallelPrefixSum(degrees);
+    DestID_ *neighs = new DestID_[offsets[num_nodes_]];
+    // offsets advance as insertion points, then are shifted back down
+    gen.VisitEdges(spec, MakeBinnedVisitor(num_nodes_,
+        [&offsets, neighs] (NodeID_ u, DestID_ v) {
+          neighs[fetch_and_add(offsets[u], 1)] = v;
+        }, &max_seen));
+    for (NodeID_ n = num_nodes_; n >= 0; n--)
+      offsets[n] = n != 0 ? offsets[n - 1] : 0;
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (NodeID_ n = 0; n < num_nodes_; n++) {
+      std::sort(neighs + offsets[n], neighs + offsets[n + 1]);
+      DestID_ *n_start = neighs + offsets[n];
+      degrees[n] = std::unique(n_start, neighs + offsets[n + 1]) - n_start;
+    }
+    pvector<SGOffset> sq_offsets = ParallelPrefixSum(degrees);
+    degrees = pvector<NodeID_>();
+    CompactNeighs(neighs, offsets, sq_offsets);
+    offsets = pvector<SGOffset>();
+    DestID_ **index = CSRGraph<NodeID_, DestID_>::GenIndex(sq_offsets, neighs);
+    t.Stop();
+    PrintTime("Build Time", t.Seconds());
+    return CSRGraph<NodeID_, DestID_, invert>(num_nodes_, index, neighs);
+  }
+
+  // Moves each neighborhood n from neighs + offsets[n] down to
+  // neighs + sq_offsets[n] (its first sq_offsets[n+1] - sq_offsets[n] edges).
+  // Vertices go in waves: a wave is copied out to a buffer and then to its
+  // final place, both in parallel, and since neighborhoods only move toward
+  // the front, a wave only overwrites space that earlier waves already read.
+  void CompactNeighs(DestID_ *neighs, const pvector<SGOffset> &offsets,
+                     const pvector<SGOffset> &sq_offsets) {
+    const SGOffset kWaveEdges = 1 << 20;
+    pvector<DestID_> buffer(kWaveEdges);
+    NodeID_ wave_start = 0;
+    // vertices before the first removed edge are already in place
+    while ((wave_start < num_nodes_) &&
+           (offsets[wave_start + 1] == sq_offsets[wave_start + 1]))
+      wave_start++;
+    while (wave_start < num_nodes_) {
+      const SGOffset base = sq_offsets[wave_start];
+      NodeID_ wave_end = std::upper_bound(
+          sq_offsets.begin() + wave_start + 1,
+          sq_offsets.begin() + num_nodes_ + 1, base + kWaveEdges) -
+          sq_offsets.begin() - 1;
+      wave_end = std::max(wave_end, wave_start + 1);
+      const SGOffset wave_edges = sq_offsets[wave_end] - base;
+      if (wave_edges > static_cast<SGOffset>(buffer.size()))
+        buffer.resize(wave_edges);
+#pragma omp parallel for schedule(dynamic, 1024)
+      for (NodeID_ n = wave_start; n < wave_end; n++)
+        std::copy(neighs + offsets[n],
+                  neighs + offsets[n] + sq_offsets[n + 1] - sq_offsets[n],
+                  buffer.begin() + sq_offsets[n] - base);
+#pragma omp parallel for
+      for (SGOffset i = 0; i < wave_edges; i++)
+        neighs[base + i] = buffer[i];
+      wave_start = wave_end;
+    }
+  }
+
   CSRGraph<NodeID_, DestID_, invert> MakeGraph() {
+    CSRGraph<NodeID_, DestID_, invert> g = MakeGraphFromInput();
+    if (needs_weights_ && (cli_.weight_dist() != "")) {
+      Timer t;
+      t.Start();
+      Generator<NodeID_, DestID_, WeightT_>::AssignWeights(g,
+                                                          cli_.weight_dist());
+      t.Stop();
+      PrintTime("Weight Time", t.Seconds());
+    }
+    return g;
+  }
+
+  CSRGraph<NodeID_, DestID_, invert> MakeGraphFromInput() {
     CSRGraph<NodeID_, DestID_, invert> g;
     { // extra scope to trigger earlier deletion of el (save memory)
       EdgeList el;
@@ -353,8 +542,11 @@ public:
           el = r.ReadFile(needs_weights_);
         }
       } else if (cli_.scale() != -1) {
-        Generator<NodeID_, DestID_> gen(cli_.scale(), cli_.degree());
-        el = gen.GenerateEL(cli_.uniform());
+        Generator<NodeID_, DestID_> gen(cli_.scale(), cli_.degree(),
+                                        cli_.counter_rng());
+        if (in_place_ && symmetrize_ && gen.CanVisitEdges(cli_.generator()))
+          return MakeGraphFromGenerator(gen, cli_.generator());
+        el = gen.GenerateEL(cli_.generator());
       }
       g = MakeGraphFromEL(el);
     }
@@ -8,7 +8,6 @@
 #include <vector>
 
 #include "benchmark.h"
-#include "bitmap.h"
 #include "builder.h"
 #include "command_line.h"
 #include "graph.h"
@@ -119,29 +118,36 @@ pvector<NodeID> Afforest(const Graph &g, bool logging_enabled = false,
   // compression, this value represents the largest intermediate component
   NodeID c = SampleFrequentElement(comp, logging_enabled);
 
-  // Final 'link' phase over remaining edges (excluding the largest component)
+  // Final 'link' phase over remaining edges (excluding the largest component).
+  // Parts have about equal numbers of edges, but skipping the largest
+  // component leaves their work uneven, so they are still taken dynamically.
+  const VertexPartition<NodeID> &parts = g.out_parts();
   if (!g.directed()) {
-    #pragma omp parallel for schedule(dynamic, 16384)
-    for (NodeID u = 0; u < g.num_nodes(); u++) {
-      // Skip processing nodes in the largest component
-      if (comp[u] == c)
-        continue;
-      // Skip over part of neighborhood (determined by neighbor_rounds)
-      for (NodeID v : g.out_neigh(u, neighbor_rounds)) {
-        Link(u, v, comp);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int64_t p = 0; p < parts.size(); p++) {
+      for (NodeID u : parts[p]) {
+        // Skip processing nodes in the largest component
+        if (comp[u] == c)
+          continue;
+        // Skip over part of neighborhood (determined by neighbor_rounds)
+        for (NodeID v : g.out_neigh(u, neighbor_rounds)) {
+          Link(u, v, comp);
+        }
       }
     }
   } else {
-    #pragma omp parallel for schedule(dynamic, 16384)
-    for (NodeID u = 0; u < g.num_nodes(); u++) {
-      if (comp[u] == c)
-        continue;
-      for (NodeID v : g.out_neigh(u, neighbor_rounds)) {
-        Link(u, v, comp);
-      }
-      // To support directed graphs, process reverse graph completely
-      for (NodeID v : g.in_neigh(u)) {
-        Link(u, v, comp);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int64_t p = 0; p < parts.size(); p++) {
+      for (NodeID u : parts[p]) {
+        if (comp[u] == c)
+          continue;
+        for (NodeID v : g.out_neigh(u, neighbor_rounds)) {
+          Link(u, v, comp);
+        }
+        // To support directed graphs, process reverse graph completely
+        for (NodeID v : g.in_neigh(u)) {
+          Link(u, v, comp);
+        }
       }
     }
   }
@@ -170,50 +176,62 @@ void PrintCompStats(const Graph &g, const pvector<NodeID> &comp) {
 }
 
 
-// Verifies CC result by performing a BFS from a vertex in each component
-// - Asserts search does not reach a vertex with a different component label
-// - If the graph is directed, it performs the search as if it was undirected
-// - Asserts every vertex is visited (degree-0 vertex should have own label)
-bool CCVerifier(const Graph &g, const pvector<NodeID> &comp) {
-  unordered_map<NodeID, NodeID> label_to_source;
-  for (NodeID n : g.vertices())
-    label_to_source[comp[n]] = n;
-  Bitmap visited(g.num_nodes());
-  visited.reset();
+// Labels each vertex with the smallest vertex ID in its component, found by
+// serial BFS from each unvisited vertex in order (as if undirected if the
+// graph is directed), as a reference for CCVerifier
+pvector<NodeID> SerialComponents(const Graph &g) {
+  pvector<NodeID> comp(g.num_nodes(), -1);
   vector<NodeID> frontier;
   frontier.reserve(g.num_nodes());
-  for (auto label_source_pair : label_to_source) {
-    NodeID curr_label = label_source_pair.first;
-    NodeID source = label_source_pair.second;
+  for (NodeID source : g.vertices()) {
+    if (comp[source] != -1)
+      continue;
     frontier.clear();
     frontier.push_back(source);
-    visited.set_bit(source);
+    comp[source] = source;
     for (auto it = frontier.begin(); it != frontier.end(); it++) {
       NodeID u = *it;
       for (NodeID v : g.out_neigh(u)) {
-        if (comp[v] != curr_label)
-          return false;
-        if (!visited.get_bit(v)) {
-          visited.set_bit(v);
+        if (comp[v] == -1) {
+          comp[v] = source;
           frontier.push_back(v);
         }
       }
       if (g.directed()) {
         for (NodeID v : g.in_neigh(u)) {
-          if (comp[v] != curr_label)
-            return false;
-          if (!visited.get_bit(v)) {
-            visited.set_bit(v);
+          if (comp[v] == -1) {
+            comp[v] = source;
             frontier.push_back(v);
           }
         }
       }
     }
   }
-  for (NodeID n=0; n < g.num_nodes(); n++)
-    if (!visited.get_bit(n))
-      return false;
-  return true;
+  return comp;
+}
+
+
+// Verifies CC result against reference components from SerialComponents
+// (computed once by the caller):
+// - Asserts every vertex has the same label as its component's smallest vertex
+// - Asserts the smallest vertices of different components have different
+//   labels (degree-0 vertex should have own label)
+bool CCVerifier(const Graph &g, const pvector<NodeID> &oracle_comp,
+                const pvector<NodeID> &comp) {
+  bool all_ok = true;
+  #pragma omp parallel for reduction(&& : all_ok)
+  for (NodeID n = 0; n < g.num_nodes(); n++)
+    all_ok = all_ok && (comp[n] == comp[oracle_comp[n]]);
+  if (!all_ok)
+    return false;
+  vector<NodeID> root_labels;
+  for (NodeID n : g.vertices()) {
+    if (oracle_comp[n] == n)
+      root_labels.push_back(comp[n]);
+  }
+  sort(root_labels.begin(), root_labels.end());
+  return adjacent_find(root_labels.begin(), root_labels.end()) ==
+         root_labels.end();
 }
 
 
@@ -224,6 +242,11 @@ int main(int argc, char* argv[]) {
   Builder b(cli);
   Graph g = b.MakeGraph();
   auto CCBound = [&cli](const Graph& gr){ return Afforest(gr, cli.logging_en()); };
-  BenchmarkKernel(cli, g, CCBound, PrintCompStats, CCVerifier);
+  OracleCache<int, pvector<NodeID>> oracle;
+  auto VerifierBound = [&oracle](const Graph &g, const pvector<NodeID> &comp) {
+    return CCVerifier(g, oracle.Get(0, [&] { return SerialComponents(g); }),
+                      comp);
+  };
+  BenchmarkKernel(cli, g, CCBound, PrintCompStats, VerifierBound);
   return 0;
 }
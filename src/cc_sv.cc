@@ -8,7 +8,6 @@
 #include <vector>
 
 #include "benchmark.h"
-#include "bitmap.h"
 #include "builder.h"
 #include "command_line.h"
 #include "graph.h"
@@ -53,21 +52,26 @@ pvector<NodeID> ShiloachVishkin(const Graph &g) {
     comp[n] = n;
   bool change = true;
   int num_iter = 0;
+  // each part has about the same number of edges, so static is balanced
+  const VertexPartition<NodeID> &parts = g.out_parts();
   while (change) {
     change = false;
     num_iter++;
-    #pragma omp parallel for
-    for (NodeID u=0; u < g.num_nodes(); u++) {
-      for (NodeID v : g.out_neigh(u)) {
-        NodeID comp_u = comp[u];
-        NodeID comp_v = comp[v];
-        if (comp_u == comp_v) continue;
-        // Hooking condition so lower component ID wins independent of direction
-        NodeID high_comp = comp_u > comp_v ? comp_u : comp_v;
-        NodeID low_comp = comp_u + (comp_v - high_comp);
-        if (high_comp == comp[high_comp]) {
-          change = true;
-          comp[high_comp] = low_comp;
+    #pragma omp parallel for schedule(static)
+    for (int64_t p=0; p < parts.size(); p++) {
+      for (NodeID u : parts[p]) {
+        for (NodeID v : g.out_neigh(u)) {
+          NodeID comp_u = comp[u];
+          NodeID comp_v = comp[v];
+          if (comp_u == comp_v) continue;
+          // Hooking condition so lower component ID wins regardless of
+          // direction
+          NodeID high_comp = comp_u > comp_v ? comp_u : comp_v;
+          NodeID low_comp = comp_u + (comp_v - high_comp);
+          if (high_comp == comp[high_comp]) {
+            change = true;
+            comp[high_comp] = low_comp;
+          }
         }
       }
     }
@@ -102,50 +106,62 @@ void PrintCompStats(const Graph &g, const pvector<NodeID> &comp) {
 }
 
 
-// Verifies CC result by performing a BFS from a vertex in each component
-// - Asserts search does not reach a vertex with a different component label
-// - If the graph is directed, it performs the search as if it was undirected
-// - Asserts every vertex is visited (degree-0 vertex should have own label)
-bool CCVerifier(const Graph &g, const pvector<NodeID> &comp) {
-  unordered_map<NodeID, NodeID> label_to_source;
-  for (NodeID n : g.vertices())
-    label_to_source[comp[n]] = n;
-  Bitmap visited(g.num_nodes());
-  visited.reset();
+// Labels each vertex with the smallest vertex ID in its component, found by
+// serial BFS from each unvisited vertex in order (as if undirected if the
+// graph is directed), as a reference for CCVerifier
+pvector<NodeID> SerialComponents(const Graph &g) {
+  pvector<NodeID> comp(g.num_nodes(), -1);
   vector<NodeID> frontier;
   frontier.reserve(g.num_nodes());
-  for (auto label_source_pair : label_to_source) {
-    NodeID curr_label = label_source_pair.first;
-    NodeID source = label_source_pair.second;
+  for (NodeID source : g.vertices()) {
+    if (comp[source] != -1)
+      continue;
     frontier.clear();
     frontier.push_back(source);
-    visited.set_bit(source);
+    comp[source] = source;
     for (auto it = frontier.begin(); it != frontier.end(); it++) {
       NodeID u = *it;
       for (NodeID v : g.out_neigh(u)) {
-        if (comp[v] != curr_label)
-          return false;
-        if (!visited.get_bit(v)) {
-          visited.set_bit(v);
+        if (comp[v] == -1) {
+          comp[v] = source;
           frontier.push_back(v);
         }
       }
       if (g.directed()) {
         for (NodeID v : g.in_neigh(u)) {
-          if (comp[v] != curr_label)
-            return false;
-          if (!visited.get_bit(v)) {
-            visited.set_bit(v);
+          if (comp[v] == -1) {
+            comp[v] = source;
             frontier.push_back(v);
           }
         }
       }
     }
   }
-  for (NodeID n=0; n < g.num_nodes(); n++)
-    if (!visited.get_bit(n))
-      return false;
-  return true;
+  return comp;
+}
+
+
+// Verifies CC result against reference components from SerialComponents
+// (computed once by the caller):
+// - Asserts every vertex has the same label as its component's smallest vertex
+// - Asserts the smallest vertices of different components have different
+//   labels (degree-0 vertex should have own label)
+bool CCVerifier(const Graph &g, const pvector<NodeID> &oracle_comp,
+                const pvector<NodeID> &comp) {
+  bool all_ok = true;
+  #pragma omp parallel for reduction(&& : all_ok)
+  for (NodeID n = 0; n < g.num_nodes(); n++)
+    all_ok = all_ok && (comp[n] == comp[oracle_comp[n]]);
+  if (!all_ok)
+    return false;
+  vector<NodeID> root_labels;
+  for (NodeID n : g.vertices()) {
+    if (oracle_comp[n] == n)
+      root_labels.push_back(comp[n]);
+  }
+  sort(root_labels.begin(), root_labels.end());
+  return adjacent_find(root_labels.begin(), root_labels.end()) ==
+         root_labels.end();
 }
 
 
@@ -155,6 +171,11 @@ int main(int argc, char* argv[]) {
     return -1;
   Builder b(cli);
   Graph g = b.MakeGraph();
-  BenchmarkKernel(cli, g, ShiloachVishkin, PrintCompStats, CCVerifier);
+  OracleCache<int, pvector<NodeID>> oracle;
+  auto VerifierBound = [&oracle](const Graph &g, const pvector<NodeID> &comp) {
+    return CCVerifier(g, oracle.Get(0, [&] { return SerialComponents(g); }),
+                      comp);
+  };
+  BenchmarkKernel(cli, g, ShiloachVishkin, PrintCompStats, VerifierBound);
   return 0;
 }
@@ -0,0 +1,94 @@
+// Copyright (c) 2015, The Regents of the University of California (Regents)
+// See LICENSE.txt for license details
+
+#ifndef CHUNKED_ARRAY_H_
+#define CHUNKED_ARRAY_H_
+
+#include <algorithm>
+#include <cinttypes>
+#include <vector>
+
+#include "platform_atomics.h"
+
+
+/*
+GAP Benchmark Suite
+Class:  ChunkedArray
+
+Array that grows by fixed-size chunks, allocated only when first needed
+ - New chunks are value-initialized (e.g. zeroed for numbers and pointers)
+ - Memory is proportional to the largest index actually used, not max_size
+ - Chunks are never moved, so growing it doesn't invalidate other threads'
+   writes, and it can be grown in parallel (Reserve or CopyIn) without locks
+ - Chunks are kept until destruction, so reusing it (e.g. across trials)
+   doesn't allocate again
+*/
+
+
+template <typename T_>
+class ChunkedArray {
+ public:
+  static const int kChunkBits = 16;
+  static const size_t kChunkSize = size_t(1) << kChunkBits;
+
+  // max_size only bounds the chunk directory (one pointer per chunk)
+  explicit ChunkedArray(size_t max_size)
+      : chunks_(max_size / kChunkSize + 1, nullptr) {}
+
+  ~ChunkedArray() {
+    for (T_ *chunk : chunks_)
+      delete[] chunk;
+  }
+
+  ChunkedArray(const ChunkedArray &other) = delete;
+  ChunkedArray& operator=(const ChunkedArray &other) = delete;
+
+  T_& operator[](size_t n) {
+    return chunks_[n >> kChunkBits][n & (kChunkSize - 1)];
+  }
+
+  const T_& operator[](size_t n) const {
+    return chunks_[n >> kChunkBits][n & (kChunkSize - 1)];
+  }
+
+  // Makes indices [begin, end) usable, safe to call in parallel
+  void Reserve(size_t begin, size_t end) {
+    if (begin == end)
+      return;
+    for (size_t c = begin >> kChunkBits; c <= (end - 1) >> kChunkBits; c++) {
+      if (chunks_[c] == nullptr) {
+        T_ *new_chunk = new T_[kChunkSize]();
+        if (!compare_and_swap(chunks_[c], static_cast<T_*>(nullptr),
+                              new_chunk))
+          delete[] new_chunk;
+      }
+    }
+  }
+
+  // Copies [first, last) to indices starting at start (reserving them)
+  template <typename IterT_>
+  void CopyIn(size_t start, IterT_ first, IterT_ last) {
+    size_t end = start + (last - first);
+    Reserve(start, end);
+    while (start < end) {
+      size_t in_chunk = std::min(end, ((start >> kChunkBits) + 1) <<
+                                      kChunkBits) - start;
+      std::copy(first, first + in_chunk, &(*this)[start]);
+      first += in_chunk;
+      start += in_chunk;
+    }
+  }
+
+  // Memory held by the chunks allocated so far
+  size_t allocated_bytes() const {
+    size_t num_chunks = 0;
+    for (T_ *chunk : chunks_)
+      num_chunks += chunk != nullptr;
+    return num_chunks * kChunkSize * sizeof(T_);
+  }
+
+ private:
+  std::vector<T_*> chunks_;
+};
+
+#endif  // CHUNKED_ARRAY_H_
@@ -28,14 +28,16 @@ protected:
   int argc_;
   char **argv_;
   std::string name_;
-  std::string get_args_ = "f:g:hk:su:m";
+  std::string get_args_ = "f:g:hk:su:mG:cW:";
   std::vector<std::string> help_strings_;
 
   int scale_ = -1;
   int degree_ = 16;
   std::string filename_ = "";
   bool symmetrize_ = false;
-  bool uniform_ = false;
+  std::string generator_ = "kron";
+  bool counter_rng_ = false;
+  std::string weight_dist_ = "";
   bool in_place_ = false;
 
   void AddHelpLine(char opt, std::string opt_arg, std::string text,
@@ -61,6 +63,13 @@ public:
     AddHelpLine('u', "scale", "generate 2^scale uniform-random graph");
     AddHelpLine('k', "degree", "average degree for synthetic graph",
                 std::to_string(degree_));
+    AddHelpLine('G', "gen[:p]",
+                "-g generator: kron|rmat|uniform|grid2d|grid3d|ba|sbm",
+                generator_);
+    AddHelpLine('c', "", "counter-based RNG for -g (edges generated alone)",
+                "false");
+    AddHelpLine('W', "dist[:p]",
+                "weights: uniform|exp|normal|powerlaw|unit|degree");
     AddHelpLine('m', "", "reduces memory usage during graph building", "false");
   }
 
@@ -97,12 +106,21 @@ public:
       symmetrize_ = true;
       break;
     case 'u':
-      uniform_ = true;
+      generator_ = "uniform";
       scale_ = atoi(opt_arg);
       break;
     case 'm':
       in_place_ = true;
       break;
+    case 'G':
+      generator_ = std::string(opt_arg);
+      break;
+    case 'c':
+      counter_rng_ = true;
+      break;
+    case 'W':
+      weight_dist_ = std::string(opt_arg);
+      break;
     }
   }
 
@@ -118,7 +136,10 @@ public:
   int degree() const { return degree_; }
   std::string filename() const { return filename_; }
   bool symmetrize() const { return symmetrize_; }
-  bool uniform() const { return uniform_; }
+  bool uniform() const { return generator_ == "uniform"; }
+  std::string generator() const { return generator_; }
+  bool counter_rng() const { return counter_rng_; }
+  std::string weight_dist() const { return weight_dist_; }
   bool in_place() const { return in_place_; }
 };
 
@@ -241,18 +262,69 @@ public:
   double tolerance() const { return tolerance_; }
 };
 
+class CLBFS : public CLApp {
+  int alpha_ = 15;
+  int beta_ = 18;
+  bool tune_direction_ = false;
+  bool beta_given_ = false;
+  std::string output_ = "parents";
+
+public:
+  CLBFS(int argc, char **argv, std::string name) : CLApp(argc, argv, name) {
+    get_args_ += "A:B:o:";
+    AddHelpLine('A', "a", "switch to bottom-up at alpha a (or auto to tune)",
+                std::to_string(alpha_));
+    AddHelpLine('B', "b", "switch back to top-down at beta b",
+                std::to_string(beta_));
+    AddHelpLine('o', "out", "output: parents|depths|visited", output_);
+  }
+
+  void HandleArg(signed char opt, char *opt_arg) override {
+    switch (opt) {
+    case 'A':
+      tune_direction_ = std::string(opt_arg) == "auto";
+      if (!tune_direction_)
+        alpha_ = std::max(atoi(opt_arg), 1);
+      break;
+    case 'B':
+      beta_ = std::max(atoi(opt_arg), 1);
+      beta_given_ = true;
+      break;
+    case 'o':
+      output_ = std::string(opt_arg);
+      break;
+    default:
+      CLApp::HandleArg(opt, opt_arg);
+    }
+  }
+
+  int alpha() const { return alpha_; }
+  int beta() const { return beta_; }
+  bool tune_direction() const { return tune_direction_; }
+  bool beta_given() const { return beta_given_; }
+  std::string output() const { return output_; }
+};
+
 template <typename WeightT_> class CLDelta : public CLApp {
   WeightT_ delta_ = 1;
+  bool auto_delta_ = false;
+  bool adapt_delta_ = false;
 
 public:
   CLDelta(int argc, char **argv, std::string name) : CLApp(argc, argv, name) {
     get_args_ += "d:";
-    AddHelpLine('d', "d", "delta parameter", std::to_string(delta_));
+    AddHelpLine('d', "d", "delta parameter (or auto, or adapt to also grow it)",
+                std::to_string(delta_));
   }
 
   void HandleArg(signed char opt, char *opt_arg) override {
     switch (opt) {
     case 'd':
+      auto_delta_ = (std::string(opt_arg) == "auto") ||
+                    (std::string(opt_arg) == "adapt");
+      adapt_delta_ = std::string(opt_arg) == "adapt";
+      if (auto_delta_)
+        break;
       if (std::is_floating_point<WeightT_>::value)
         delta_ = static_cast<WeightT_>(atof(opt_arg));
       else
@@ -264,6 +336,98 @@ public:
   }
 
   WeightT_ delta() const { return delta_; }
+  bool auto_delta() const { return auto_delta_; }
+  bool adapt_delta() const { return adapt_delta_; }
+};
+
+template <typename WeightT_> class CLSSSP : public CLDelta<WeightT_> {
+  bool soa_layout_ = false;
+  bool cache_permutation_ = false;
+  bool light_heavy_ = false;
+  int batch_size_ = 1;
+  bool shortest_path_tree_ = false;
+  int64_t target_ = -1;
+  bool random_targets_ = false;
+  std::string queries_filename_ = "";
+  int num_landmarks_ = 0;
+  std::string kernel_ = "auto";
+  std::string path_policy_ = "shortest";
+
+public:
+  CLSSSP(int argc, char **argv, std::string name)
+      : CLDelta<WeightT_>(argc, argv, name) {
+    this->get_args_ += "LPHB:Tt:Q:A:K:p:";
+    this->AddHelpLine('L', "", "store IDs & weights in separate arrays",
+                      "false");
+    this->AddHelpLine('P', "", "cache edge permutation for -w in <file>.perm",
+                      "false");
+    this->AddHelpLine('H', "", "relax heavy edges once per bin (light/heavy)",
+                      "false");
+    this->AddHelpLine('B', "k", "run sources in batches of k", "1");
+    this->AddHelpLine('T', "", "also compute parents (shortest-path tree)",
+                      "false");
+    this->AddHelpLine('t', "v", "point-to-point queries to v (or random)");
+    this->AddHelpLine('Q', "file", "point-to-point queries (source target)");
+    this->AddHelpLine('A', "k", "use k landmarks for queries (ALT)", "0");
+    this->AddHelpLine('K', "k", "kernel: delta, buckets, radix, or auto",
+                      "auto");
+    this->AddHelpLine('p', "p", "paths: shortest|widest|reliable|hops:h",
+                      "shortest");
+  }
+
+  void HandleArg(signed char opt, char *opt_arg) override {
+    switch (opt) {
+    case 'L':
+      soa_layout_ = true;
+      break;
+    case 'P':
+      cache_permutation_ = true;
+      break;
+    case 'H':
+      light_heavy_ = true;
+      break;
+    case 'B':
+      batch_size_ = std::max(atoi(opt_arg), 1);
+      break;
+    case 'T':
+      shortest_path_tree_ = true;
+      break;
+    case 't':
+      random_targets_ = std::string(opt_arg) == "random";
+      if (!random_targets_)
+        target_ = atol(opt_arg);
+      break;
+    case 'Q':
+      queries_filename_ = std::string(opt_arg);
+      break;
+    case 'A':
+      num_landmarks_ = std::max(atoi(opt_arg), 0);
+      break;
+    case 'K':
+      kernel_ = std::string(opt_arg);
+      break;
+    case 'p':
+      path_policy_ = std::string(opt_arg);
+      break;
+    default:
+      CLDelta<WeightT_>::HandleArg(opt, opt_arg);
+    }
+  }
+
+  bool soa_layout() const { return soa_layout_; }
+  bool cache_permutation() const { return cache_permutation_; }
+  bool light_heavy() const { return light_heavy_; }
+  int batch_size() const { return batch_size_; }
+  bool shortest_path_tree() const { return shortest_path_tree_; }
+  int64_t target() const { return target_; }
+  bool random_targets() const { return random_targets_; }
+  std::string queries_filename() const { return queries_filename_; }
+  int num_landmarks() const { return num_landmarks_; }
+  std::string kernel() const { return kernel_; }
+  std::string path_policy() const { return path_policy_; }
+  bool point_to_point() const {
+    return (target_ != -1) || random_targets_ || (queries_filename_ != "");
+  }
 };
 
 class CLConvert : public CLBase {
@@ -271,14 +435,21 @@ class CLConvert : public CLBase {
   bool out_weighted_ = false;
   bool out_el_ = false;
   bool out_sg_ = false;
+  bool checksums_ = false;
+  std::string weight_type_ = "int32";
+  std::string weights_filename_ = "";
 
 public:
   CLConvert(int argc, char **argv, std::string name)
       : CLBase(argc, argv, name) {
-    get_args_ += "e:b:w";
+    get_args_ += "e:b:wCt:V:";
     AddHelpLine('b', "file", "output serialized graph to file");
     AddHelpLine('e', "file", "output edge list to file");
     AddHelpLine('w', "file", "make output weighted");
+    AddHelpLine('C', "", "add checksums to serialized graph", "false");
+    AddHelpLine('t', "type", "weight type (int32|float|double|uint16|uint8)",
+                weight_type_);
+    AddHelpLine('V', "file", "output weights vector (for -w) to file");
   }
 
   void HandleArg(signed char opt, char *opt_arg) override {
@@ -294,6 +465,16 @@ public:
     case 'w':
       out_weighted_ = true;
       break;
+    case 'C':
+      checksums_ = true;
+      break;
+    case 't':
+      weight_type_ = std::string(opt_arg);
+      break;
+    case 'V':
+      out_weighted_ = true;
+      weights_filename_ = std::string(opt_arg);
+      break;
     default:
       CLBase::HandleArg(opt, opt_arg);
     }
@@ -303,6 +484,9 @@ public:
   bool out_weighted() const { return out_weighted_; }
   bool out_el() const { return out_el_; }
   bool out_sg() const { return out_sg_; }
+  bool checksums() const { return checksums_; }
+  std::string weight_type() const { return weight_type_; }
+  std::string weights_filename() const { return weights_filename_; }
 };
 
 #endif // COMMAND_LINE_H_
@@ -7,25 +7,55 @@
 #include "builder.h"
 #include "command_line.h"
 #include "graph.h"
+#include "sg_header.h"
 #include "writer.h"
 
 using namespace std;
 
+// Builds and writes graph with weights of type WeightT_ (independent of the
+// WeightT the kernels are compiled with), and/or just its out-edge weights
+// in CSR order for use with a kernel's -w
+template <typename WeightT_>
+void ConvertWeighted(const CLConvert &cli) {
+  typedef NodeWeight<NodeID, WeightT_> WNodeT;
+  BuilderBase<NodeID, WNodeT, WeightT_> bw(cli);
+  CSRGraph<NodeID, WNodeT> wg = bw.MakeGraph();
+  wg.PrintStats();
+  if (cli.weights_filename() != "") {
+    pvector<WeightT_> weights(wg.num_edges_directed());
+    const WNodeT *neighs = wg.out_neigh(0).begin();
+    #pragma omp parallel for
+    for (int64_t e = 0; e < wg.num_edges_directed(); e++)
+      weights[e] = neighs[e].w;
+    VectorWriter<WeightT_> vw(cli.weights_filename());
+    vw.WriteSerialized(weights.data(), weights.size());
+  }
+  if (cli.out_filename() != "") {
+    WriterBase<NodeID, WNodeT> ww(wg);
+    ww.WriteGraph(cli.out_filename(), cli.out_sg(), cli.checksums());
+  }
+}
+
 int main(int argc, char* argv[]) {
   CLConvert cli(argc, argv, "converter");
   cli.ParseArgs();
   if (cli.out_weighted()) {
-    WeightedBuilder bw(cli);
-    WGraph wg = bw.MakeGraph();
-    wg.PrintStats();
-    WeightedWriter ww(wg);
-    ww.WriteGraph(cli.out_filename(), cli.out_sg());
+    switch (SGWeightTypeFromName(cli.weight_type())) {
+      case kSGInt32:  ConvertWeighted<int32_t>(cli);  break;
+      case kSGFloat:  ConvertWeighted<float>(cli);    break;
+      case kSGDouble: ConvertWeighted<double>(cli);   break;
+      case kSGUInt16: ConvertWeighted<uint16_t>(cli); break;
+      case kSGUInt8:  ConvertWeighted<uint8_t>(cli);  break;
+      default:
+        cout << "Unrecognized weight type: " << cli.weight_type() << endl;
+        return -1;
+    }
   } else {
     Builder b(cli);
     Graph g = b.MakeGraph();
     g.PrintStats();
     Writer w(g);
-    w.WriteGraph(cli.out_filename(), cli.out_sg());
+    w.WriteGraph(cli.out_filename(), cli.out_sg(), cli.checksums());
   }
   return 0;
 }
@@ -0,0 +1,94 @@
+// Copyright (c) 2015, The Regents of the University of California (Regents)
+// See LICENSE.txt for license details
+
+#ifndef FRONTIER_H_
+#define FRONTIER_H_
+
+#include <cinttypes>
+
+#include "bitmap.h"
+#include "sliding_queue.h"
+
+
+/*
+GAP Benchmark Suite
+Class:  Frontier
+
+Traversal frontier that is either sparse (a SlidingQueue of vertices) or
+dense (a Bitmap), for kernels that switch between top-down and bottom-up
+ - Each step reads whichever representation the frontier is in and advances
+   it to the representation it produced, so no conversion is needed between
+   steps that can work on either (e.g. top-down steps iterating set bits)
+ - ToDense converts lazily, only when a step needs a bitmap and the frontier
+   is still a queue
+*/
+
+
+template <typename NodeID_>
+class Frontier {
+ public:
+  explicit Frontier(size_t num_nodes)
+      : queue_(num_nodes), curr_(num_nodes), next_(num_nodes), dense_(false),
+        dense_size_(0) {
+    curr_.reset();
+    next_.reset();
+  }
+
+  // Starts over with a sparse frontier holding only source
+  void Reset(NodeID_ source) {
+    queue_.reset();
+    queue_.push_back(source);
+    queue_.slide_window();
+    dense_ = false;
+  }
+
+  bool dense() const { return dense_; }
+
+  int64_t size() const { return dense_ ? dense_size_ : queue_.size(); }
+
+  bool empty() const { return size() == 0; }
+
+  // Current vertices when sparse, and where steps push the next frontier
+  SlidingQueue<NodeID_>& queue() { return queue_; }
+
+  // Current vertices when dense
+  const Bitmap& bitmap() const { return curr_; }
+
+  // Where steps producing a dense frontier write it
+  Bitmap& next_bitmap() { return next_; }
+
+  void ToDense() {
+    if (dense_)
+      return;
+    curr_.reset();
+    #pragma omp parallel for
+    for (auto q_iter = queue_.begin(); q_iter < queue_.end(); q_iter++)
+      curr_.set_bit_atomic(*q_iter);
+    dense_size_ = queue_.size();
+    queue_.slide_window();
+    dense_ = true;
+  }
+
+  // After a step pushed the next frontier to queue()
+  void AdvanceSparse() {
+    queue_.slide_window();
+    dense_ = false;
+  }
+
+  // After a step wrote the next frontier (of size vertices) to next_bitmap()
+  void AdvanceDense(int64_t size) {
+    next_.update_summary();
+    curr_.swap(next_);
+    dense_size_ = size;
+    dense_ = true;
+  }
+
+ private:
+  SlidingQueue<NodeID_> queue_;
+  Bitmap curr_;
+  Bitmap next_;
+  bool dense_;
+  int64_t dense_size_;
+};
+
+#endif  // FRONTIER_H_
@@ -7,9 +7,14 @@
 #include <algorithm>
 #include <cassert>
 #include <cinttypes>
+#include <cmath>
 #include <cstdint>
+#include <cstdlib>
 #include <limits>
 #include <random>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "graph.h"
 #include "pvector.h"
@@ -23,11 +28,24 @@ Author: Scott Beamer
 
 Given scale and degree, generates edgelist for synthetic graph
  - Intended to be called from Builder
- - GenerateEL(uniform) generates and returns the edgelist
- - Can generate uniform random (uniform=true) or R-MAT graph according
-   to Graph500 parameters (uniform=false)
+ - GenerateEL(spec) generates and returns the edgelist, or VisitEdges(spec)
+   streams the same edges (except for ba) without storing them, where spec is
+   name[:param,param,...] (defaults in parentheses)
+   - kron: R-MAT according to Graph500 parameters
+   - rmat:A,B,C: R-MAT with given quadrant probabilities (0.57,0.19,0.19)
+   - uniform: uniform random
+   - grid2d:p, grid3d:p: 2D/3D grid (road-like, high diameter) with each edge
+     dropped with probability p (0.25), IDs kept in grid order, degree unused
+   - ba:m: Barabasi-Albert preferential attachment with m edges per vertex
+     (degree/2)
+   - sbm:k,f: stochastic block model with k equal blocks and fraction f of
+     edges within a block (16,0.9)
  - Can also randomize weights within a weighted edgelist (InsertWeights)
  - Blocking/reseeding is for parallelism with deterministic output edgelist
+ - Optionally (counter_rng) kron/rmat/uniform instead draw from CounterRNG,
+   so each edge is a pure function of its index and can be generated alone
+   (CounterRMatEdge, CounterUniformEdge) without seeding a block. These
+   produce different (but equally deterministic) graphs than the default.
 */
 
 
@@ -65,6 +83,150 @@ class UniDist {
 };
 
 
+// Generator and weight distribution specs are name[:param,param,...]
+inline std::string SpecName(const std::string &spec) {
+  return spec.substr(0, spec.find(':'));
+}
+
+inline std::vector<double> SpecParams(const std::string &spec) {
+  std::vector<double> params;
+  size_t colon = spec.find(':');
+  if (colon == std::string::npos)
+    return params;
+  std::istringstream ss(spec.substr(colon + 1));
+  std::string param;
+  while (std::getline(ss, param, ','))
+    params.push_back(std::atof(param.c_str()));
+  return params;
+}
+
+
+// Counter-based RNG (SplitMix64 over Weyl sequences): value i of stream s is
+// a pure function of (seed, s, i), so no state needs to be carried or seeded
+class CounterRNG {
+ public:
+  explicit CounterRNG(uint64_t seed) : key_(Mix64(seed)) {}
+
+  uint64_t operator()(uint64_t stream, uint64_t i) const {
+    return Draw(StreamKey(stream), i);
+  }
+
+  // Drawing several values from one stream only needs to mix its key once
+  uint64_t StreamKey(uint64_t stream) const {
+    return Mix64(key_ + stream * kGamma);
+  }
+
+  static uint64_t Draw(uint64_t stream_key, uint64_t i) {
+    return Mix64(stream_key + (i + 1) * kGamma);
+  }
+
+ private:
+  static const uint64_t kGamma = 0x9e3779b97f4a7c15ull;
+  uint64_t key_;
+};
+
+
+// Maps 64 random bits (and endpoint degrees) to a weight drawn from the
+// distribution given by spec (defaults in parentheses):
+//  - uniform:lo,hi     uniform in [lo,hi] (1,255)
+//  - exp:mean          exponential (64)
+//  - normal:mean,sd    normal truncated to positive weights (128,32)
+//  - powerlaw:alpha,lo Pareto with density ~ x^-alpha above lo (2,1)
+//  - unit              all weights 1
+//  - degree:lo,hi      uniform in [lo,hi] divided by log2(2 + smaller degree
+//                      of the endpoints), so hub-to-hub edges are cheaper
+// Integer weight types round to nearest (at least 1), floating point don't
+template <typename WeightT_>
+class WeightDist {
+ public:
+  enum Kind {kUniform, kExp, kNormal, kPowerLaw, kUnit, kDegree};
+
+  explicit WeightDist(const std::string &spec) {
+    std::string name = SpecName(spec);
+    std::vector<double> params = SpecParams(spec);
+    auto param = [&params] (size_t i, double def) {
+      return i < params.size() ? params[i] : def;
+    };
+    if ((name == "uniform") || (name == "degree")) {
+      kind_ = name == "uniform" ? kUniform : kDegree;
+      a_ = param(0, 1);
+      b_ = param(1, 255);
+    } else if (name == "exp") {
+      kind_ = kExp;
+      a_ = param(0, 64);
+    } else if (name == "normal") {
+      kind_ = kNormal;
+      a_ = param(0, 128);
+      b_ = param(1, 32);
+    } else if (name == "powerlaw") {
+      kind_ = kPowerLaw;
+      a_ = param(0, 2);
+      b_ = param(1, 1);
+      if (a_ <= 1) {
+        std::cout << "Power-law weights need alpha > 1" << std::endl;
+        std::exit(-32);
+      }
+    } else if (name == "unit") {
+      kind_ = kUnit;
+    } else {
+      std::cout << "Unknown weight distribution: " << name << std::endl;
+      std::exit(-32);
+    }
+  }
+
+  bool uses_degrees() const { return kind_ == kDegree; }
+
+  WeightT_ operator()(uint64_t rand_bits, int64_t deg_u = 0,
+                      int64_t deg_v = 0) const {
+    const double kTwoNeg53 = 1.0 / (1ull << 53);
+    double uni = (rand_bits >> 11) * kTwoNeg53;  // [0,1)
+    double x = 1;
+    switch (kind_) {
+      case kUniform:
+      case kDegree:
+        if (std::is_integral<WeightT_>::value)
+          x = std::floor(a_ + uni * (std::floor(b_) - a_ + 1));
+        else
+          x = a_ + uni * (b_ - a_);
+        if (kind_ == kDegree)
+          x /= std::log2(2 + std::min(deg_u, deg_v));
+        break;
+      case kExp:
+        x = -a_ * std::log1p(-uni);
+        break;
+      case kNormal: {
+        // Box-Muller with second uniform from low bits
+        double uni2 = ((rand_bits & 0x7ff) + 0.5) / 2048;
+        x = a_ + b_ * std::sqrt(-2 * std::log1p(-uni)) *
+                      std::cos(2 * M_PI * uni2);
+        break;
+      }
+      case kPowerLaw:
+        x = b_ * std::pow(1 - uni, -1 / (a_ - 1));
+        break;
+      case kUnit:
+        break;
+    }
+    return ToWeight(x);
+  }
+
+ private:
+  static WeightT_ ToWeight(double x) {
+    const double max_w = std::numeric_limits<WeightT_>::max();
+    if (std::is_integral<WeightT_>::value)
+      return static_cast<WeightT_>(std::min(std::max(std::round(x), 1.0),
+                                            max_w));
+    if (x <= 0)
+      return std::numeric_limits<WeightT_>::min();
+    return static_cast<WeightT_>(std::min(x, max_w));
+  }
+
+  Kind kind_;
+  double a_ = 0;
+  double b_ = 0;
+};
+
+
 template <typename NodeID_, typename DestID_ = NodeID_,
           typename WeightT_ = NodeID_,
           typename uNodeID_ = typename std::make_unsigned<NodeID_>::type,
@@ -78,7 +240,8 @@ class Generator {
   typedef pvector<Edge> EdgeList;
 
  public:
-  Generator(int scale, int degree) {
+  Generator(int scale, int degree, bool counter_rng = false)
+      : use_counter_rng_(counter_rng), counter_rng_(kRandSeed) {
     scale_ = scale;
     num_nodes_ = 1l << scale;
     num_edges_ = num_nodes_ * degree;
@@ -91,78 +254,285 @@ class Generator {
     }
   }
 
-  void PermuteIDs(EdgeList &el) {
+  pvector<NodeID_> MakePermutation() {
     pvector<NodeID_> permutation(num_nodes_);
     rng_t_ rng(kRandSeed);
     #pragma omp parallel for
     for (NodeID_ n=0; n < num_nodes_; n++)
       permutation[n] = n;
     shuffle(permutation.begin(), permutation.end(), rng);
+    return permutation;
+  }
+
+  void PermuteIDs(EdgeList &el) {
+    pvector<NodeID_> permutation = MakePermutation();
+    const int64_t el_size = el.size();
     #pragma omp parallel for
-    for (int64_t e=0; e < num_edges_; e++)
+    for (int64_t e=0; e < el_size; e++)
       el[e] = Edge(permutation[el[e].u], permutation[el[e].v]);
   }
 
-  EdgeList MakeUniformEL() {
-    EdgeList el(num_edges_);
+  // Edge e of uniform graph, only depends on e (for use_counter_rng_)
+  Edge CounterUniformEdge(int64_t e) const {
+    const uint64_t mask = num_nodes_ - 1;
+    const uint64_t stream_key = counter_rng_.StreamKey(e);
+    return Edge(CounterRNG::Draw(stream_key, 0) & mask,
+                CounterRNG::Draw(stream_key, 1) & mask);
+  }
+
+  // Edge e of R-MAT graph, only depends on e (for use_counter_rng_), with
+  // each 64-bit draw used for two levels of recursion
+  Edge CounterRMatEdge(int64_t e, uint32_t A, uint32_t B, uint32_t C) const {
+    NodeID_ src = 0, dst = 0;
+    const uint64_t stream_key = counter_rng_.StreamKey(e);
+    uint64_t draw = 0;
+    for (int depth=0; depth < scale_; depth++) {
+      if (depth % 2 == 0)
+        draw = CounterRNG::Draw(stream_key, depth / 2);
+      else
+        draw >>= 32;
+      RMatLevel(static_cast<uint32_t>(draw), A, B, C, src, dst);
+    }
+    return Edge(src, dst);
+  }
+
+  // Generators below call visit(e, edge) in parallel for every edge index e,
+  // so the same edges can be produced repeatedly without being stored. Each
+  // thread calls its own copy of visit, destroyed once the thread is done, so
+  // visitors can buffer per thread and flush from their destructors.
+  template <typename VisitorT_>
+  void VisitUniform(VisitorT_ visit) {
+    if (use_counter_rng_) {
+      #pragma omp parallel
+      {
+        VisitorT_ thread_visit(visit);
+        #pragma omp for
+        for (int64_t e=0; e < num_edges_; e++)
+          thread_visit(e, CounterUniformEdge(e));
+      }
+      return;
+    }
     #pragma omp parallel
     {
+      VisitorT_ thread_visit(visit);
       rng_t_ rng;
       UniDist<NodeID_, rng_t_> udist(num_nodes_-1, rng);
       #pragma omp for
       for (int64_t block=0; block < num_edges_; block+=block_size) {
         rng.seed(kRandSeed + block/block_size);
         for (int64_t e=block; e < std::min(block+block_size, num_edges_); e++) {
-          el[e] = Edge(udist(), udist());
+          NodeID_ u = udist();
+          thread_visit(e, Edge(u, udist()));
         }
       }
     }
-    return el;
   }
 
-  EdgeList MakeRMatEL() {
+  template <typename VisitorT_>
+  void VisitRMat(double a, double b, double c, VisitorT_ visit) {
+    if ((a < 0) || (b < 0) || (c < 0) || (a + b + c > 1)) {
+      std::cout << "Invalid R-MAT parameters: " << a << "," << b << "," << c;
+      std::cout << std::endl;
+      std::exit(-32);
+    }
     const uint32_t max = std::numeric_limits<uint32_t>::max();
-    const uint32_t A = 0.57*max, B = 0.19*max, C = 0.19*max;
-    EdgeList el(num_edges_);
+    const uint32_t A = a*max, B = b*max, C = c*max;
+    if (use_counter_rng_) {
+      #pragma omp parallel
+      {
+        VisitorT_ thread_visit(visit);
+        #pragma omp for
+        for (int64_t e=0; e < num_edges_; e++)
+          thread_visit(e, CounterRMatEdge(e, A, B, C));
+      }
+      return;
+    }
     #pragma omp parallel
     {
+      VisitorT_ thread_visit(visit);
       std::mt19937 rng;
       #pragma omp for
       for (int64_t block=0; block < num_edges_; block+=block_size) {
         rng.seed(kRandSeed + block/block_size);
         for (int64_t e=block; e < std::min(block+block_size, num_edges_); e++) {
           NodeID_ src = 0, dst = 0;
-          for (int depth=0; depth < scale_; depth++) {
-            uint32_t rand_point = rng();
-            src = src << 1;
-            dst = dst << 1;
-            if (rand_point < A+B) {
-              if (rand_point > A)
-                dst++;
-            } else {
-              src++;
-              if (rand_point > A+B+C)
-                dst++;
-            }
+          for (int depth=0; depth < scale_; depth++)
+            RMatLevel(rng(), A, B, C, src, dst);
+          thread_visit(e, Edge(src, dst));
+        }
+      }
+    }
+  }
+
+  // Edge e connects vertex e/dims to its successor along dimension e%dims,
+  // becoming a self-loop (removed when built) at the border or if dropped
+  template <typename VisitorT_>
+  void VisitGrid(int dims, double drop_prob, VisitorT_ visit) {
+    int64_t extent[3], stride[3];
+    int bits_left = scale_;
+    int64_t next_stride = 1;
+    for (int d=0; d < dims; d++) {
+      int bits = bits_left / (dims - d);
+      bits_left -= bits;
+      extent[d] = 1l << bits;
+      stride[d] = next_stride;
+      next_stride *= extent[d];
+    }
+    const int64_t num_grid_edges = num_nodes_ * dims;
+    #pragma omp parallel
+    {
+      VisitorT_ thread_visit(visit);
+      rng_t_ rng;
+      #pragma omp for
+      for (int64_t block=0; block < num_grid_edges; block+=block_size) {
+        rng.seed(kRandSeed + block/block_size);
+        for (int64_t e=block; e < std::min(block+block_size, num_grid_edges);
+             e++) {
+          NodeID_ u = e / dims;
+          int d = e % dims;
+          bool keep = !Bernoulli(rng, drop_prob);
+          if (keep && ((u / stride[d]) % extent[d] + 1 < extent[d]))
+            thread_visit(e, Edge(u, u + stride[d]));
+          else
+            thread_visit(e, Edge(u, u));
+        }
+      }
+    }
+  }
+
+  template <typename VisitorT_>
+  void VisitSBM(int64_t num_blocks, double in_block_frac, VisitorT_ visit) {
+    if ((num_blocks < 1) || (num_blocks > num_nodes_)) {
+      std::cout << "Invalid number of SBM blocks: " << num_blocks << std::endl;
+      std::exit(-32);
+    }
+    const int64_t block_nodes = num_nodes_ / num_blocks;
+    const int64_t last_block_nodes = num_nodes_ - (num_blocks-1)*block_nodes;
+    #pragma omp parallel
+    {
+      VisitorT_ thread_visit(visit);
+      rng_t_ rng;
+      UniDist<NodeID_, rng_t_> udist(num_nodes_-1, rng);
+      UniDist<NodeID_, rng_t_> block_dist(block_nodes-1, rng);
+      UniDist<NodeID_, rng_t_> last_block_dist(last_block_nodes-1, rng);
+      #pragma omp for
+      for (int64_t block=0; block < num_edges_; block+=block_size) {
+        rng.seed(kRandSeed + block/block_size);
+        for (int64_t e=block; e < std::min(block+block_size, num_edges_); e++) {
+          NodeID_ u = udist();
+          NodeID_ v;
+          if (Bernoulli(rng, in_block_frac)) {
+            int64_t b = std::min(u / block_nodes, num_blocks - 1);
+            v = b*block_nodes + (b == num_blocks-1 ? last_block_dist() :
+                                                      block_dist());
+          } else {
+            v = udist();
           }
-          el[e] = Edge(src, dst);
+          thread_visit(e, Edge(u, v));
         }
       }
     }
+  }
+
+  // Vertex e/m attaches its e-th edge to the endpoint at a random position
+  // r <= 2e of the conceptual array [src0, dst0, src1, dst1, ...], so targets
+  // are picked proportional to degree. Positions are drawn in parallel first,
+  // and then resolved by following dst positions back to a src.
+  EdgeList MakeBarabasiAlbertEL(int64_t m) {
+    if (m < 1) {
+      std::cout << "Barabasi-Albert needs at least 1 edge per vertex";
+      std::cout << std::endl;
+      std::exit(-32);
+    }
+    const int64_t num_ba_edges = num_nodes_ * m;
+    pvector<int64_t> positions(num_ba_edges);
+    #pragma omp parallel
+    {
+      std::mt19937_64 rng;
+      #pragma omp for
+      for (int64_t block=0; block < num_ba_edges; block+=block_size) {
+        rng.seed(kRandSeed + block/block_size);
+        for (int64_t e=block; e < std::min(block+block_size, num_ba_edges); e++)
+          positions[e] = rng() % (2*e + 1);
+      }
+    }
+    EdgeList el(num_ba_edges);
+    #pragma omp parallel for
+    for (int64_t e=0; e < num_ba_edges; e++) {
+      int64_t pos = positions[e];
+      while (pos % 2 == 1)
+        pos = positions[pos / 2];
+      el[e] = Edge(e / m, (pos / 2) / m);
+    }
     PermuteIDs(el);
-    // TIME_PRINT("Shuffle", std::shuffle(el.begin(), el.end(),
-    //                                    std::mt19937()));
     return el;
   }
 
-  EdgeList GenerateEL(bool uniform) {
+  // Generators that can be visited (all but ba, which needs all edges to
+  // resolve any one of them)
+  static bool CanVisitEdges(const std::string &spec) {
+    std::string name = SpecName(spec);
+    return (name == "kron") || (name == "rmat") || (name == "uniform") ||
+           (name == "grid2d") || (name == "grid3d") || (name == "sbm");
+  }
+
+  // Calls visit(e, edge) in parallel for every edge e < NumEdges(spec) of the
+  // graph given by spec, with final (permuted) IDs, through a copy of visit
+  // per thread
+  template <typename VisitorT_>
+  void VisitEdges(const std::string &spec, VisitorT_ visit) {
+    std::string name = SpecName(spec);
+    std::vector<double> params = SpecParams(spec);
+    auto param = [&params] (size_t i, double def) {
+      return i < params.size() ? params[i] : def;
+    };
+    if ((name == "kron") || (name == "rmat") || (name == "sbm")) {
+      pvector<NodeID_> permutation = MakePermutation();
+      auto permuted = [&permutation, visit] (int64_t e, Edge edge) mutable {
+        visit(e, Edge(permutation[edge.u], permutation[edge.v]));
+      };
+      if (name == "kron")
+        VisitRMat(0.57, 0.19, 0.19, permuted);
+      else if (name == "rmat")
+        VisitRMat(param(0, 0.57), param(1, 0.19), param(2, 0.19), permuted);
+      else
+        VisitSBM(param(0, 16), param(1, 0.9), permuted);
+    } else if (name == "uniform") {
+      VisitUniform(visit);
+    } else if ((name == "grid2d") || (name == "grid3d")) {
+      VisitGrid(name == "grid2d" ? 2 : 3, param(0, 0.25), visit);
+    } else {
+      std::cout << "Unknown generator: " << name << std::endl;
+      std::exit(-32);
+    }
+  }
+
+  // Number of edge indices generated for spec (including dropped edges)
+  int64_t NumEdges(const std::string &spec) const {
+    std::string name = SpecName(spec);
+    if (name == "grid2d")
+      return num_nodes_ * 2;
+    if (name == "grid3d")
+      return num_nodes_ * 3;
+    return num_edges_;
+  }
+
+  EdgeList GenerateEL(const std::string &spec) {
     EdgeList el;
     Timer t;
     t.Start();
-    if (uniform)
-      el = MakeUniformEL();
-    else
-      el = MakeRMatEL();
+    if (CanVisitEdges(spec)) {
+      el = EdgeList(NumEdges(spec));
+      VisitEdges(spec, [&el] (int64_t e, Edge edge) { el[e] = edge; });
+    } else if (SpecName(spec) == "ba") {
+      std::vector<double> params = SpecParams(spec);
+      int64_t m = params.empty() ? std::max(num_edges_ / num_nodes_ / 2,
+                                            int64_t(1)) : params[0];
+      el = MakeBarabasiAlbertEL(m);
+    } else {
+      std::cout << "Unknown generator: " << spec << std::endl;
+      std::exit(-32);
+    }
     t.Stop();
     PrintTime("Generate Time", t.Seconds());
     return el;
@@ -187,7 +557,71 @@ class Generator {
     }
   }
 
+  template <bool invert_>
+  static void AssignWeights(CSRGraph<NodeID_, NodeID_, invert_> &g,
+                            const std::string &spec) {}
+
+  // Overwrites weights of built graph with draws from WeightDist(spec). Each
+  // edge's randomness hashes its endpoints (unordered if undirected), so all
+  // stored copies of an edge get the same weight.
+  template <bool invert_>
+  static void AssignWeights(
+      CSRGraph<NodeID_, NodeWeight<NodeID_, WeightT_>, invert_> &g,
+      const std::string &spec) {
+    WeightDist<WeightT_> dist(spec);
+    CounterRNG rng(kRandSeed);
+    auto weight = [&g, &dist, &rng] (NodeID_ u, NodeID_ v) {
+      if (!g.directed() && (v < u))
+        std::swap(u, v);
+      uint64_t bits = CounterRNG::Draw(rng.StreamKey(u), v);
+      if (dist.uses_degrees())
+        return dist(bits, g.out_degree(u), g.out_degree(v));
+      return dist(bits);
+    };
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (NodeID_ u=0; u < g.num_nodes(); u++) {
+      for (NodeWeight<NodeID_, WeightT_> &wn : g.out_neigh(u))
+        wn.w = weight(u, wn.v);
+    }
+    if (g.directed())
+      AssignInWeights(g, weight, std::integral_constant<bool, invert_>());
+  }
+
  private:
+  template <typename GraphT_, typename WeightFunc_>
+  static void AssignInWeights(GraphT_ &g, WeightFunc_ weight, std::true_type) {
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (NodeID_ v=0; v < g.num_nodes(); v++) {
+      for (NodeWeight<NodeID_, WeightT_> &wn : g.in_neigh(v))
+        wn.w = weight(wn.v, v);
+    }
+  }
+
+  template <typename GraphT_, typename WeightFunc_>
+  static void AssignInWeights(GraphT_ &g, WeightFunc_ weight,
+                              std::false_type) {}
+
+  // Descends one level of R-MAT recursion, picking quadrant with rand_point
+  static void RMatLevel(uint32_t rand_point, uint32_t A, uint32_t B,
+                        uint32_t C, NodeID_ &src, NodeID_ &dst) {
+    src = src << 1;
+    dst = dst << 1;
+    if (rand_point < A+B) {
+      if (rand_point > A)
+        dst++;
+    } else {
+      src++;
+      if (rand_point > A+B+C)
+        dst++;
+    }
+  }
+
+  static bool Bernoulli(rng_t_ &rng, double p) {
+    return rng() < p * static_cast<double>(rng_t_::max());
+  }
+
+  bool use_counter_rng_;
+  CounterRNG counter_rng_;
   int scale_;
   int64_t num_nodes_;
   int64_t num_edges_;
@@ -5,10 +5,13 @@
 #define GRAPH_H_
 
 #include <algorithm>
+#include <cassert>
 #include <cinttypes>
 #include <cstddef>
 #include <iostream>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "benchmark.h"
 #include "pvector.h"
@@ -45,19 +48,21 @@ template <typename NodeID_, typename WeightT_> struct NodeWeight {
   // doesn't check WeightT_s, needed to remove self edges
   bool operator==(const NodeID_ &rhs) const { return v == rhs; }
 
-  operator NodeID_() { return v; }
+  operator NodeID_() const { return v; }
 };
 
 template <typename NodeID_, typename WeightT_>
 std::ostream &operator<<(std::ostream &os,
                          const NodeWeight<NodeID_, WeightT_> &nw) {
-  os << nw.v << " " << nw.w;
+  os << nw.v << " " << +nw.w;  // promote so 8-bit weights print as numbers
   return os;
 }
 
 template <typename NodeID_, typename WeightT_>
 std::istream &operator>>(std::istream &is, NodeWeight<NodeID_, WeightT_> &nw) {
-  is >> nw.v >> nw.w;
+  decltype(+nw.w) w = 0;  // promoted so 8-bit weights aren't parsed as chars
+  is >> nw.v >> w;
+  nw.w = static_cast<WeightT_>(w);
   return is;
 }
 
@@ -84,6 +89,132 @@ typedef int32_t SGID;
 typedef EdgePair<SGID> SGEdge;
 typedef int64_t SGOffset;
 
+// Vertices split into ranges with about equal work, counting each vertex's
+// edges plus one for the vertex itself, computed from a CSR index
+//  - kPartsPerThread parts for each thread available when built, but no more
+//    than one per 64 vertices, so small graphs still give every thread work
+//  - Loops over the parts can be scheduled statically when each vertex costs
+//    about its degree, or dynamically with one part per chunk otherwise
+//  - Part boundaries are multiples of 64, so bitmaps indexed by vertex are
+//    split on word boundaries and threads don't share cache lines of arrays
+//  - A vertex with many edges can still make its part heavy, since parts
+//    never split a vertex's edges
+template <typename NodeID_>
+class VertexPartition {
+  static const int64_t kAlign = 64;
+  static const int64_t kPartsPerThread = 64;
+
+  // Threads in a parallel region (1 without OpenMP)
+  static int64_t NumThreads() {
+    int64_t num_threads = 0;
+    #pragma omp parallel reduction(+ : num_threads)
+    num_threads++;
+    return num_threads;
+  }
+
+ public:
+  VertexPartition() {}
+
+  template <typename DestID_>
+  VertexPartition(DestID_ *const *index, int64_t num_nodes) {
+    const int64_t num_parts = std::max<int64_t>(1,
+        std::min(kPartsPerThread * NumThreads(),
+                 (num_nodes + kAlign - 1) / kAlign));
+    bounds_ = pvector<NodeID_>(num_parts + 1);
+    const int64_t total = (index[num_nodes] - index[0]) + num_nodes;
+    auto work_before = [&](int64_t v) { return (index[v] - index[0]) + v; };
+    #pragma omp parallel for
+    for (int64_t p = 0; p < num_parts; p++) {
+      // first vertex with at least p/num_parts of the work before it
+      int64_t target = total * p / num_parts;
+      int64_t lo = 0, hi = num_nodes;
+      while (lo < hi) {
+        int64_t mid = lo + (hi - lo) / 2;
+        if (work_before(mid) < target)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      bounds_[p] = lo - lo % kAlign;
+    }
+    bounds_[num_parts] = num_nodes;
+  }
+
+  int64_t size() const { return std::max<int64_t>(bounds_.size() - 1, 0); }
+
+  Range<NodeID_> operator[](int64_t p) const {
+    return Range<NodeID_>(bounds_[p], bounds_[p + 1]);
+  }
+
+ private:
+  pvector<NodeID_> bounds_;
+};
+
+// For each out-edge (by offset among out-edges), offset of the same edge among
+// the in-edges, for a CSR whose in-neighborhoods list sources in increasing
+// order (as built). Stably sorting out-edges by destination gives the in-edge
+// order, so this is a counting sort without any searches, in two passes to
+// bound the counters: first into ranges of destinations (with counts per
+// chunk of sources so chunks are placed in parallel), then within each range.
+//  - out_offset(u) and in_offset(v) give CSR offsets, dest(e) the destination
+//  - Uses a temporary array of edge offsets, like the permutation itself
+template <typename OutOffsetF_, typename DestF_, typename InOffsetF_>
+pvector<SGOffset> TransposePermutation(int64_t num_nodes,
+                                       OutOffsetF_ out_offset, DestF_ dest,
+                                       InOffsetF_ in_offset) {
+  const int64_t kNumChunks = 256;
+  const int kMaxRangeBits = 10;
+  int range_shift = 0;
+  while ((num_nodes - 1) >> (range_shift + kMaxRangeBits) > 0)
+    range_shift++;
+  const int64_t num_ranges = ((num_nodes - 1) >> range_shift) + 1;
+  const int64_t num_edges = out_offset(num_nodes);
+  const int64_t chunk_nodes = (num_nodes + kNumChunks - 1) / kNumChunks;
+  // counts[c][r]: edges from chunk c into range r, then where they go
+  pvector<SGOffset> counts(kNumChunks * num_ranges, 0);
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int64_t c = 0; c < kNumChunks; c++) {
+    SGOffset *chunk_counts = counts.data() + c * num_ranges;
+    int64_t end = std::min(num_nodes, (c + 1) * chunk_nodes);
+    for (SGOffset e = out_offset(std::min(num_nodes, c * chunk_nodes));
+         e < out_offset(end); e++)
+      chunk_counts[dest(e) >> range_shift]++;
+  }
+  pvector<SGOffset> range_starts(num_ranges + 1);
+  SGOffset total = 0;
+  for (int64_t r = 0; r < num_ranges; r++) {
+    range_starts[r] = total;
+    for (int64_t c = 0; c < kNumChunks; c++) {
+      SGOffset count = counts[c * num_ranges + r];
+      counts[c * num_ranges + r] = total;
+      total += count;
+    }
+  }
+  range_starts[num_ranges] = total;
+  pvector<SGOffset> by_range(num_edges);
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int64_t c = 0; c < kNumChunks; c++) {
+    SGOffset *chunk_next = counts.data() + c * num_ranges;
+    int64_t end = std::min(num_nodes, (c + 1) * chunk_nodes);
+    for (SGOffset e = out_offset(std::min(num_nodes, c * chunk_nodes));
+         e < out_offset(end); e++)
+      by_range[chunk_next[dest(e) >> range_shift]++] = e;
+  }
+  pvector<SGOffset> perm(num_edges);
+  pvector<SGOffset> next_in(num_nodes);
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int64_t r = 0; r < num_ranges; r++) {
+    int64_t end = std::min(num_nodes, (r + 1) << range_shift);
+    for (int64_t v = r << range_shift; v < end; v++)
+      next_in[v] = in_offset(v);
+    for (SGOffset i = range_starts[r]; i < range_starts[r + 1]; i++) {
+      SGOffset e = by_range[i];
+      perm[e] = next_in[dest(e)]++;
+    }
+  }
+  return perm;
+}
+
 template <class NodeID_, class DestID_ = NodeID_, bool MakeInverse = true>
 class CSRGraph {
   // Used for *non-negative* offsets within a neighborhood
@@ -126,7 +257,8 @@ public:
 
   CSRGraph(int64_t num_nodes, DestID_ **index, DestID_ *neighs)
       : directed_(false), num_nodes_(num_nodes), out_index_(index),
-        out_neighbors_(neighs), in_index_(index), in_neighbors_(neighs) {
+        out_neighbors_(neighs), in_index_(index), in_neighbors_(neighs),
+        out_parts_(index, num_nodes) {
     num_edges_ = (out_index_[num_nodes_] - out_index_[0]) / 2;
   }
 
@@ -134,15 +266,19 @@ public:
            DestID_ **in_index, DestID_ *in_neighs)
       : directed_(true), num_nodes_(num_nodes), out_index_(out_index),
         out_neighbors_(out_neighs), in_index_(in_index),
-        in_neighbors_(in_neighs) {
+        in_neighbors_(in_neighs), out_parts_(out_index, num_nodes) {
     num_edges_ = out_index_[num_nodes_] - out_index_[0];
+    if (in_index_ != nullptr)
+      in_parts_ = VertexPartition<NodeID_>(in_index_, num_nodes_);
   }
 
   CSRGraph(CSRGraph &&other)
       : directed_(other.directed_), num_nodes_(other.num_nodes_),
         num_edges_(other.num_edges_), out_index_(other.out_index_),
         out_neighbors_(other.out_neighbors_), in_index_(other.in_index_),
-        in_neighbors_(other.in_neighbors_) {
+        in_neighbors_(other.in_neighbors_),
+        out_parts_(std::move(other.out_parts_)),
+        in_parts_(std::move(other.in_parts_)) {
     other.num_edges_ = -1;
     other.num_nodes_ = -1;
     other.out_index_ = nullptr;
@@ -163,6 +299,8 @@ public:
       out_neighbors_ = other.out_neighbors_;
       in_index_ = other.in_index_;
       in_neighbors_ = other.in_neighbors_;
+      out_parts_ = std::move(other.out_parts_);
+      in_parts_ = std::move(other.in_parts_);
       other.num_edges_ = -1;
       other.num_nodes_ = -1;
       other.out_index_ = nullptr;
@@ -241,13 +379,72 @@ public:
 
   Range<NodeID_> vertices() const { return Range<NodeID_>(num_nodes()); }
 
+  // Vertices split into ranges with about equal numbers of out-edges (or
+  // in-edges), computed once when the graph is built (see VertexPartition)
+  const VertexPartition<NodeID_>& out_parts() const { return out_parts_; }
+
+  const VertexPartition<NodeID_>& in_parts() const {
+    static_assert(MakeInverse, "Graph inversion disabled but reading inverse");
+    return directed_ ? in_parts_ : out_parts_;
+  }
+
+  // For each out-edge (by index into out-neighbors), index of the same edge
+  // among the in-neighbors (see TransposePermutation). Computed once in
+  // linear time, and lets ReplaceWeights scatter weights without searching.
+  pvector<SGOffset> InEdgePermutation() const {
+    static_assert(MakeInverse, "Graph inversion disabled but reading inverse");
+    const DestID_ *out_start = out_index_[0];
+    const DestID_ *in_start = in_index_[0];
+    if (directed_) {
+      return TransposePermutation(
+          num_nodes_,
+          [&](int64_t u) -> SGOffset { return out_index_[u] - out_start; },
+          [&](SGOffset e) { return static_cast<NodeID_>(out_start[e]); },
+          [&](int64_t v) -> SGOffset { return in_index_[v] - in_start; });
+    }
+    const int64_t num_out = out_index_[num_nodes_] - out_start;
+    pvector<SGOffset> perm(num_out);
+    #pragma omp parallel for
+    for (int64_t e = 0; e < num_out; e++)
+      perm[e] = e;
+    return perm;
+  }
+
+  // Position-dependent checksum of the degrees and out-neighbor IDs (not
+  // weights), for validating data cached next to a graph file such as
+  // InEdgePermutation. Matches SoACSRGraph::TopologyChecksum.
+  uint64_t TopologyChecksum() const {
+    const int64_t in_salt = num_nodes_;
+    const int64_t edge_salt = 2 * num_nodes_;
+    const bool has_in = directed_ && (in_index_ != nullptr);
+    uint64_t sum = 0;
+#pragma omp parallel for reduction(+ : sum) schedule(dynamic, 1024)
+    for (NodeID_ u = 0; u < num_nodes_; u++) {
+      sum += Mix64(out_degree(u) + Mix64(u));
+      if (has_in)
+        sum += Mix64((in_index_[u+1] - in_index_[u]) + Mix64(in_salt + u));
+      for (const DestID_ *it = out_index_[u]; it < out_index_[u + 1]; it++) {
+        int64_t e = it - out_index_[0];
+        sum += Mix64(static_cast<NodeID_>(*it) + Mix64(edge_salt + e));
+      }
+    }
+    return sum;
+  }
+
   template <typename Dest = DestID_, typename = typename std::enable_if<
                                          !std::is_same<NodeID_, Dest>::value>>
   void ReplaceWeights(const std::vector<typename Dest::WeightT> &weights) {
-    using WNode = NodeWeight<NodeID_, typename Dest::WeightT>;
+    ReplaceWeights(weights.data(), weights.size());
+  }
 
+  // Writes weights to out-edges and (if directed) scatters them to in-edges
+  // using perm from InEdgePermutation (computed here if not given)
+  template <typename Dest = DestID_, typename = typename std::enable_if<
+                                         !std::is_same<NodeID_, Dest>::value>>
+  void ReplaceWeights(const typename Dest::WeightT *weights, size_t num_weights,
+                      const SGOffset *perm = nullptr) {
     const int64_t out_edges = out_index_[num_nodes_] - out_index_[0];
-    assert(weights.size() == static_cast<size_t>(out_edges) &&
+    assert(num_weights == static_cast<size_t>(out_edges) &&
            "weights vector has incorrect size");
 
 #pragma omp parallel for
@@ -256,20 +453,14 @@ public:
     }
 
     if (directed_ && MakeInverse) {
-      auto compare_node = [](const WNode &a, const WNode &b) {
-        return a.v < b.v;
-      };
-
+      pvector<SGOffset> computed_perm;
+      if (perm == nullptr) {
+        computed_perm = InEdgePermutation();
+        perm = computed_perm.data();
+      }
 #pragma omp parallel for
-      for (NodeID_ u = 0; u < num_nodes_; u++) {
-        for (WNode &wn : out_neigh(u)) {
-          WNode dummy(u);
-
-          auto inneigh = in_neigh(wn.v);
-          auto it = std::lower_bound(inneigh.begin(), inneigh.end(), dummy,
-                                     compare_node);
-          (*it).w = wn.w;
-        }
+      for (int64_t i = 0; i < out_edges; i++) {
+        in_neighbors_[perm[i]].w = weights[i];
       }
     }
   }
@@ -282,6 +473,8 @@ private:
   DestID_ *out_neighbors_;
   DestID_ **in_index_;
   DestID_ *in_neighbors_;
+  VertexPartition<NodeID_> out_parts_;
+  VertexPartition<NodeID_> in_parts_;
 };
 
 #endif // GRAPH_H_
@@ -40,17 +40,21 @@ pvector<ScoreT> PageRankPullGS(const Graph &g, int max_iters, double epsilon=0,
   #pragma omp parallel for
   for (NodeID n=0; n < g.num_nodes(); n++)
     outgoing_contrib[n] = init_score / g.out_degree(n);
+  // each part has about the same number of in-edges, so static is balanced
+  const VertexPartition<NodeID> &parts = g.in_parts();
   for (int iter=0; iter < max_iters; iter++) {
     double error = 0;
-    #pragma omp parallel for reduction(+ : error) schedule(dynamic, 16384)
-    for (NodeID u=0; u < g.num_nodes(); u++) {
-      ScoreT incoming_total = 0;
-      for (NodeID v : g.in_neigh(u))
-        incoming_total += outgoing_contrib[v];
-      ScoreT old_score = scores[u];
-      scores[u] = base_score + kDamp * incoming_total;
-      error += fabs(scores[u] - old_score);
-      outgoing_contrib[u] = scores[u] / g.out_degree(u);
+    #pragma omp parallel for reduction(+ : error) schedule(static)
+    for (int64_t p=0; p < parts.size(); p++) {
+      for (NodeID u : parts[p]) {
+        ScoreT incoming_total = 0;
+        for (NodeID v : g.in_neigh(u))
+          incoming_total += outgoing_contrib[v];
+        ScoreT old_score = scores[u];
+        scores[u] = base_score + kDamp * incoming_total;
+        error += fabs(scores[u] - old_score);
+        outgoing_contrib[u] = scores[u] / g.out_degree(u);
+      }
     }
     if (logging_enabled)
       PrintStep(iter, error);
@@ -0,0 +1,97 @@
+// Copyright (c) 2015, The Regents of the University of California (Regents)
+// See LICENSE.txt for license details
+
+#ifndef RADIX_HEAP_H_
+#define RADIX_HEAP_H_
+
+#include <cassert>
+#include <cinttypes>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+/*
+GAP Benchmark Suite
+Class:  RadixHeap
+
+Monotone min-priority queue for non-negative keys, e.g. for serial Dijkstra
+ - Keys pushed must be no smaller than the last key popped
+ - Keys are compared by their bit patterns as unsigned integers, which orders
+   non-negative integers and floats correctly, so both work as keys
+ - Bucket 0 holds keys equal to the last popped key, and bucket i > 0 holds
+   keys whose highest bit that differs from it is bit i-1. Popping from an
+   empty bucket 0 redistributes the lowest non-empty bucket into lower ones,
+   so each item moves at most once per key bit.
+*/
+
+
+template <typename KeyT_, typename ValueT_>
+class RadixHeap {
+  static_assert((sizeof(KeyT_) == 4) || (sizeof(KeyT_) == 8),
+                "keys must be 32 or 64 bits");
+  typedef typename std::conditional<sizeof(KeyT_) == 4, uint32_t,
+                                    uint64_t>::type BitsT;
+  typedef std::pair<BitsT, ValueT_> Item;
+  static const int kNumBuckets = sizeof(BitsT) * 8 + 1;
+
+ public:
+  RadixHeap() : buckets_(kNumBuckets), size_(0), last_(0) {}
+
+  bool empty() const { return size_ == 0; }
+
+  size_t size() const { return size_; }
+
+  void push(KeyT_ key, ValueT_ value) {
+    BitsT bits = ToBits(key);
+    assert(bits >= last_ && "radix heap keys must be monotone");
+    buckets_[Bucket(bits)].push_back(Item(bits, value));
+    size_++;
+  }
+
+  // Removes and returns a (key, value) with the smallest key
+  std::pair<KeyT_, ValueT_> pop() {
+    if (buckets_[0].empty()) {
+      int b = 1;
+      while (buckets_[b].empty())
+        b++;
+      BitsT new_last = buckets_[b][0].first;
+      for (const Item &item : buckets_[b])
+        new_last = item.first < new_last ? item.first : new_last;
+      last_ = new_last;
+      for (const Item &item : buckets_[b])
+        buckets_[Bucket(item.first)].push_back(item);
+      buckets_[b].clear();
+    }
+    Item item = buckets_[0].back();
+    buckets_[0].pop_back();
+    size_--;
+    return std::make_pair(FromBits(item.first), item.second);
+  }
+
+ private:
+  static BitsT ToBits(KeyT_ key) {
+    BitsT bits;
+    std::memcpy(&bits, &key, sizeof(bits));
+    return bits;
+  }
+
+  static KeyT_ FromBits(BitsT bits) {
+    KeyT_ key;
+    std::memcpy(&key, &bits, sizeof(key));
+    return key;
+  }
+
+  int Bucket(BitsT bits) const {
+    if (bits == last_)
+      return 0;
+    return 64 - __builtin_clzll(static_cast<uint64_t>(bits ^ last_));
+  }
+
+  std::vector<std::vector<Item>> buckets_;
+  size_t size_;
+  BitsT last_;
+};
+
+#endif  // RADIX_HEAP_H_
@@ -4,6 +4,11 @@
 #ifndef READER_H_
 #define READER_H_
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -13,6 +18,7 @@
 
 #include "graph.h"
 #include "pvector.h"
+#include "sg_header.h"
 #include "util.h"
 
 /*
@@ -24,7 +30,7 @@ Given filename, returns an edgelist or the entire graph (if serialized)
  - Intended to be called from Builder
  - Determines file format from the filename's suffix
  - If the input graph is serialized (.sg or .wsg), reads the graph
-   directly into the returned graph instance
+   directly into the returned graph instance (either format from sg_header.h)
  - Otherwise, reads the file and returns an edgelist
 */
 
@@ -251,27 +257,8 @@ public:
     return el;
   }
 
-  CSRGraph<NodeID_, DestID_, invert> ReadSerializedGraph() {
-    bool weighted = GetSuffix() == ".wsg";
-    if (!std::is_same<NodeID_, SGID>::value) {
-      std::cout << "serialized graphs only allowed for 32bit" << std::endl;
-      std::exit(-5);
-    }
-    if (!weighted && !std::is_same<NodeID_, DestID_>::value) {
-      std::cout << ".sg not allowed for weighted graphs" << std::endl;
-      std::exit(-5);
-    }
-    if (weighted && std::is_same<NodeID_, DestID_>::value) {
-      std::cout << ".wsg only allowed for weighted graphs" << std::endl;
-      std::exit(-5);
-    }
-    std::ifstream file(filename_);
-    if (!file.is_open()) {
-      std::cout << "Couldn't open file " << filename_ << std::endl;
-      std::exit(-6);
-    }
-    Timer t;
-    t.Start();
+  // Reads version 1 layout (no header), which starts at beginning of file
+  CSRGraph<NodeID_, DestID_, invert> ReadLegacySerialized(std::ifstream &file) {
     bool directed;
     SGOffset num_nodes, num_edges;
     DestID_ **index = nullptr, **inv_index = nullptr;
@@ -292,15 +279,284 @@ public:
       file.read(reinterpret_cast<char *>(inv_neighs), num_neigh_bytes);
       inv_index = CSRGraph<NodeID_, DestID_>::GenIndex(offsets, inv_neighs);
     }
-    file.close();
-    t.Stop();
-    PrintTime("Read Time", t.Seconds());
     if (directed)
       return CSRGraph<NodeID_, DestID_, invert>(num_nodes, index, neighs,
                                                 inv_index, inv_neighs);
     else
       return CSRGraph<NodeID_, DestID_, invert>(num_nodes, index, neighs);
   }
+
+  void CheckHeader(const SGHeader &header) {
+    if (header.version > kSGVersion) {
+      std::cout << "Serialized graph version " << header.version
+                << " is newer than supported (" << kSGVersion << ")"
+                << std::endl;
+      std::exit(-7);
+    }
+    if ((header.id_bytes != sizeof(SGID)) ||
+        (header.offset_bytes != sizeof(SGOffset))) {
+      std::cout << "Serialized graph has " << int(header.id_bytes)
+                << "B IDs and " << int(header.offset_bytes)
+                << "B offsets, expected " << sizeof(SGID) << "B and "
+                << sizeof(SGOffset) << "B" << std::endl;
+      std::exit(-7);
+    }
+    uint8_t expected_type = SGDestWeightType<NodeID_, DestID_>::value;
+    bool weighted = expected_type != kSGUnweighted;
+    if (((header.weight_type == kSGUnweighted) == weighted) ||
+        (SGWeightTypeName(header.weight_type) == "unknown")) {
+      std::cout << "Serialized graph has " << SGWeightTypeName(
+                       header.weight_type)
+                << " weights but " << SGWeightTypeName(expected_type)
+                << " expected" << std::endl;
+      std::exit(-7);
+    }
+    if (header.weight_type != expected_type) {
+      std::cout << "Converting " << SGWeightTypeName(header.weight_type)
+                << " weights to " << SGWeightTypeName(expected_type)
+                << std::endl;
+    } else if (header.neigh_bytes != sizeof(DestID_)) {
+      std::cout << "Serialized graph has " << header.neigh_bytes
+                << "B neighbors, expected " << sizeof(DestID_) << "B"
+                << std::endl;
+      std::exit(-7);
+    }
+  }
+
+  // Checks the sections to be read have exactly the sizes implied by the
+  // node and edge counts, since they are read into buffers of those sizes
+  void CheckSections(const SGHeader &header, bool read_inverse) {
+    if ((header.num_nodes < 0) || (header.num_edges < 0)) {
+      std::cout << "Serialized graph has " << header.num_nodes << " nodes and "
+                << header.num_edges << " edges" << std::endl;
+      std::exit(-7);
+    }
+    const uint64_t index_bytes = (header.num_nodes + 1) * sizeof(SGOffset);
+    const uint64_t neigh_bytes = header.num_edges * header.neigh_bytes;
+    for (int id = 0; id < (read_inverse ? kSGNumSections : kSGInIndex); id++) {
+      bool is_index = (id == kSGOutIndex) || (id == kSGInIndex);
+      uint64_t expected = is_index ? index_bytes : neigh_bytes;
+      if (header.sections[id].bytes != expected) {
+        std::cout << "Serialized graph section " << id << " has "
+                  << header.sections[id].bytes << " bytes, expected "
+                  << expected << std::endl;
+        std::exit(-7);
+      }
+    }
+  }
+
+  // Offsets become pointers into the neighbor array, so they must stay in it
+  void CheckOffsets(const pvector<SGOffset> &offsets, int64_t num_edges) {
+    const int64_t num_nodes = offsets.size() - 1;
+    bool in_order = true;
+    #pragma omp parallel for reduction(&& : in_order)
+    for (int64_t n = 0; n < num_nodes; n++)
+      in_order = in_order && (offsets[n] <= offsets[n+1]);
+    if (!in_order || (offsets[0] != 0) || (offsets[num_nodes] != num_edges)) {
+      std::cout << "Serialized graph has offsets outside its " << num_edges
+                << " edges" << std::endl;
+      std::exit(-7);
+    }
+  }
+
+  void ReadSection(std::ifstream &file, const SGHeader &header,
+                   SGSectionID id, char *dest) {
+    const SGSection &section = header.sections[id];
+    file.seekg(section.offset);
+    file.read(dest, section.bytes);
+    if (!file || (static_cast<uint64_t>(file.gcount()) != section.bytes)) {
+      std::cout << "Serialized graph truncated in section " << id << " of "
+                << filename_ << " (read " << file.gcount() << " of "
+                << section.bytes << " bytes)" << std::endl;
+      std::exit(-7);
+    }
+    if (header.has_checksums() &&
+        (SGChecksum(dest, section.bytes) != section.checksum)) {
+      std::cout << "Checksum mismatch in section " << id << " of "
+                << filename_ << std::endl;
+      std::exit(-7);
+    }
+  }
+
+  // Reads neighbors stored with FileWeightT_ weights and casts them, exiting
+  // if any weight would change (only checked if the conversion narrows)
+  template <typename FileWeightT_>
+  void ReadNeighsAs(std::ifstream &file, const SGHeader &header,
+                    SGSectionID id, DestID_ *neighs) {
+    typedef NodeWeight<NodeID_, FileWeightT_> FileWNode;
+    if (header.neigh_bytes != sizeof(FileWNode)) {
+      std::cout << "Serialized graph has " << header.neigh_bytes
+                << "B neighbors, expected " << sizeof(FileWNode) << "B"
+                << std::endl;
+      std::exit(-7);
+    }
+    pvector<FileWNode> file_neighs(header.num_edges);
+    ReadSection(file, header, id, reinterpret_cast<char *>(file_neighs.data()));
+    if (!SGWeightWidens<FileWeightT_, WeightT_>::value) {
+      bool fits = true;
+      #pragma omp parallel for reduction(&& : fits)
+      for (int64_t e = 0; e < header.num_edges; e++)
+        fits = fits && SGWeightFits<WeightT_>(file_neighs[e].w);
+      if (!fits) {
+        std::cout << "Serialized graph has " << SGWeightTypeName(
+                         header.weight_type)
+                  << " weights that don't convert exactly to "
+                  << SGWeightTypeName(SGWeightTypeOf<WeightT_>::value)
+                  << std::endl;
+        std::exit(-7);
+      }
+    }
+    #pragma omp parallel for
+    for (int64_t e = 0; e < header.num_edges; e++)
+      neighs[e] = DestID_(file_neighs[e].v,
+                          static_cast<WeightT_>(file_neighs[e].w));
+  }
+
+  // Only reachable for weighted graphs (CheckHeader rejects other mismatches)
+  void ReadConvertedNeighs(std::ifstream &file, const SGHeader &header,
+                           SGSectionID id, DestID_ *neighs, std::true_type) {
+    switch (header.weight_type) {
+      case kSGInt32:
+        ReadNeighsAs<int32_t>(file, header, id, neighs); break;
+      case kSGFloat:
+        ReadNeighsAs<float>(file, header, id, neighs); break;
+      case kSGDouble:
+        ReadNeighsAs<double>(file, header, id, neighs); break;
+      case kSGUInt16:
+        ReadNeighsAs<uint16_t>(file, header, id, neighs); break;
+      case kSGUInt8:
+        ReadNeighsAs<uint8_t>(file, header, id, neighs); break;
+    }
+  }
+
+  void ReadConvertedNeighs(std::ifstream &file, const SGHeader &header,
+                           SGSectionID id, DestID_ *neighs, std::false_type) {}
+
+  void ReadNeighs(std::ifstream &file, const SGHeader &header, SGSectionID id,
+                  DestID_ *neighs) {
+    if (header.weight_type == SGDestWeightType<NodeID_, DestID_>::value)
+      ReadSection(file, header, id, reinterpret_cast<char *>(neighs));
+    else
+      ReadConvertedNeighs(file, header, id, neighs,
+          std::integral_constant<bool,
+                                 !std::is_same<NodeID_, DestID_>::value>());
+  }
+
+  // Reads version 2 layout (see sg_header.h), header already consumed
+  CSRGraph<NodeID_, DestID_, invert> ReadSerialized(std::ifstream &file,
+                                                    const SGHeader &header) {
+    CheckHeader(header);
+    CheckSections(header, header.directed() && invert);
+    int64_t num_nodes = header.num_nodes;
+    int64_t num_edges = header.num_edges;
+    DestID_ **index = nullptr, **inv_index = nullptr;
+    DestID_ *neighs = nullptr, *inv_neighs = nullptr;
+    pvector<SGOffset> offsets(num_nodes + 1);
+    neighs = new DestID_[num_edges];
+    ReadSection(file, header, kSGOutIndex,
+                reinterpret_cast<char *>(offsets.data()));
+    CheckOffsets(offsets, num_edges);
+    ReadNeighs(file, header, kSGOutNeighs, neighs);
+    index = CSRGraph<NodeID_, DestID_>::GenIndex(offsets, neighs);
+    if (header.directed() && invert) {
+      inv_neighs = new DestID_[num_edges];
+      ReadSection(file, header, kSGInIndex,
+                  reinterpret_cast<char *>(offsets.data()));
+      CheckOffsets(offsets, num_edges);
+      ReadNeighs(file, header, kSGInNeighs, inv_neighs);
+      inv_index = CSRGraph<NodeID_, DestID_>::GenIndex(offsets, inv_neighs);
+    }
+    if (header.directed())
+      return CSRGraph<NodeID_, DestID_, invert>(num_nodes, index, neighs,
+                                                inv_index, inv_neighs);
+    else
+      return CSRGraph<NodeID_, DestID_, invert>(num_nodes, index, neighs);
+  }
+
+  CSRGraph<NodeID_, DestID_, invert> ReadSerializedGraph() {
+    bool weighted = GetSuffix() == ".wsg";
+    if (!std::is_same<NodeID_, SGID>::value) {
+      std::cout << "serialized graphs only allowed for 32bit" << std::endl;
+      std::exit(-5);
+    }
+    if (!weighted && !std::is_same<NodeID_, DestID_>::value) {
+      std::cout << ".sg not allowed for weighted graphs" << std::endl;
+      std::exit(-5);
+    }
+    if (weighted && std::is_same<NodeID_, DestID_>::value) {
+      std::cout << ".wsg only allowed for weighted graphs" << std::endl;
+      std::exit(-5);
+    }
+    std::ifstream file(filename_, std::ios::binary);
+    if (!file.is_open()) {
+      std::cout << "Couldn't open file " << filename_ << std::endl;
+      std::exit(-6);
+    }
+    Timer t;
+    t.Start();
+    CSRGraph<NodeID_, DestID_, invert> g;
+    SGHeader header;
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (file && SGHasMagic(header.magic)) {
+      g = ReadSerialized(file, header);
+    } else {
+      file.clear();
+      file.seekg(0);
+      g = ReadLegacySerialized(file);
+    }
+    file.close();
+    t.Stop();
+    PrintTime("Read Time", t.Seconds());
+    return g;
+  }
+};
+
+// Read-only view of a serialized vector (see VectorReader) mapped from file
+template <typename ValueT_> class MappedVector {
+  void *map_;
+  size_t map_bytes_;
+  int64_t size_;
+
+public:
+  MappedVector() : map_(MAP_FAILED), map_bytes_(0), size_(0) {}
+
+  MappedVector(void *map, size_t map_bytes, int64_t size)
+      : map_(map), map_bytes_(map_bytes), size_(size) {}
+
+  MappedVector(const MappedVector &other) = delete;
+
+  MappedVector(MappedVector &&other)
+      : map_(other.map_), map_bytes_(other.map_bytes_), size_(other.size_) {
+    other.map_ = MAP_FAILED;
+  }
+
+  MappedVector &operator=(MappedVector &&other) {
+    if (this != &other) {
+      ReleaseResources();
+      map_ = other.map_;
+      map_bytes_ = other.map_bytes_;
+      size_ = other.size_;
+      other.map_ = MAP_FAILED;
+    }
+    return *this;
+  }
+
+  ~MappedVector() { ReleaseResources(); }
+
+  void ReleaseResources() {
+    if (map_ != MAP_FAILED)
+      munmap(map_, map_bytes_);
+    map_ = MAP_FAILED;
+  }
+
+  const ValueT_ *data() const {
+    return reinterpret_cast<const ValueT_ *>(
+        static_cast<const char *>(map_) + sizeof(int64_t));
+  }
+
+  size_t size() const { return size_; }
+
+  const ValueT_ &operator[](size_t n) const { return data()[n]; }
 };
 
 template <typename ValueT_> class VectorReader {
@@ -360,6 +616,52 @@ public:
 
     return values;
   }
+
+  // Same format as ReadSerialized, but pages are mapped from the file (and
+  // faulted in by whoever touches them) instead of copied through a stream.
+  // For optional files (required false), a missing or malformed file gives an
+  // empty MappedVector instead of exiting.
+  MappedVector<ValueT_> MapSerialized(bool required = true) {
+    int fd = open(filename_.c_str(), O_RDONLY);
+    if (fd == -1) {
+      if (!required)
+        return MappedVector<ValueT_>();
+      std::cout << "Couldn't open file " << filename_ << std::endl;
+      std::exit(-2);
+    }
+    struct stat file_stat;
+    fstat(fd, &file_stat);
+    size_t file_bytes = file_stat.st_size;
+    if (file_bytes < sizeof(int64_t)) {
+      close(fd);
+      if (!required)
+        return MappedVector<ValueT_>();
+      std::cout << "Serialized values file " << filename_ << " too short"
+                << std::endl;
+      std::exit(-2);
+    }
+    void *map = mmap(nullptr, file_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+      if (!required)
+        return MappedVector<ValueT_>();
+      std::cout << "Couldn't map file " << filename_ << std::endl;
+      std::exit(-2);
+    }
+    madvise(map, file_bytes, MADV_SEQUENTIAL);
+    int64_t num_values = *static_cast<const int64_t *>(map);
+    if ((num_values < 0) ||
+        (static_cast<uint64_t>(num_values) >
+         (file_bytes - sizeof(int64_t)) / sizeof(ValueT_))) {
+      munmap(map, file_bytes);
+      if (!required)
+        return MappedVector<ValueT_>();
+      std::cout << "Serialized values file " << filename_ << " truncated"
+                << std::endl;
+      std::exit(-2);
+    }
+    return MappedVector<ValueT_>(map, file_bytes, num_values);
+  }
 };
 
 #endif // READER_H_
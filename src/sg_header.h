@@ -0,0 +1,203 @@
+// Copyright (c) 2015, The Regents of the University of California (Regents)
+// See LICENSE.txt for license details
+
+#ifndef SG_HEADER_H_
+#define SG_HEADER_H_
+
+#include <cinttypes>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+
+#include "util.h"
+
+
+/*
+GAP Benchmark Suite
+Class:  SGHeader
+
+Self-describing header for serialized graphs (.sg and .wsg)
+ - Version 1 files have no header: a bool (directed), two int64s (edges,
+   nodes), then the raw offset & neighbor arrays. Readers fall back to this
+   layout whenever the magic string is missing.
+ - Version 2 files begin with a kSGAlignment-byte block holding the magic,
+   version, widths of IDs/offsets/neighbors, weight type, and a section table
+ - Every section starts on a kSGAlignment boundary so it can be mmapped or
+   read with O_DIRECT
+ - Sections optionally carry a checksum (SGChecksum) verified when loaded
+ - Weighted neighbors are NodeWeight<SGID, W> records for any W with an
+   SGWeightTypeOf specialization; readers convert to their own weight type,
+   checking every weight converts exactly unless the conversion widens
+*/
+
+
+static const char kSGMagic[8] = {'G', 'A', 'P', 'B', 'S', 'S', 'G', '\0'};
+static const uint32_t kSGVersion = 2;
+static const uint64_t kSGAlignment = 4096;
+
+// Bits of SGHeader::flags
+static const uint32_t kSGDirected = 1;
+static const uint32_t kSGChecksums = 2;
+
+// Order of sections in SGHeader::sections (in-graph only used if directed)
+enum SGSectionID {
+  kSGOutIndex = 0,
+  kSGOutNeighs = 1,
+  kSGInIndex = 2,
+  kSGInNeighs = 3,
+  kSGNumSections = 4
+};
+
+// Values for SGHeader::weight_type
+enum SGWeightType : uint8_t {
+  kSGUnweighted = 0,
+  kSGInt32 = 1,
+  kSGFloat = 2,
+  kSGDouble = 3,
+  kSGUInt16 = 4,
+  kSGUInt8 = 5
+};
+
+template <typename WeightT_>
+struct SGWeightTypeOf {
+  static_assert(sizeof(WeightT_) == 0, "weight type can't be serialized");
+};
+
+template <> struct SGWeightTypeOf<int32_t> {
+  static const uint8_t value = kSGInt32;
+};
+
+template <> struct SGWeightTypeOf<float> {
+  static const uint8_t value = kSGFloat;
+};
+
+template <> struct SGWeightTypeOf<double> {
+  static const uint8_t value = kSGDouble;
+};
+
+template <> struct SGWeightTypeOf<uint16_t> {
+  static const uint8_t value = kSGUInt16;
+};
+
+template <> struct SGWeightTypeOf<uint8_t> {
+  static const uint8_t value = kSGUInt8;
+};
+
+// Weight type of a graph's neighbor type (DestID_ is NodeWeight if weighted)
+template <typename NodeID_, typename DestID_,
+          bool weighted = !std::is_same<NodeID_, DestID_>::value>
+struct SGDestWeightType {
+  static const uint8_t value = SGWeightTypeOf<typename DestID_::WeightT>::value;
+  static const uint8_t bytes = sizeof(typename DestID_::WeightT);
+};
+
+template <typename NodeID_, typename DestID_>
+struct SGDestWeightType<NodeID_, DestID_, false> {
+  static const uint8_t value = kSGUnweighted;
+  static const uint8_t bytes = 0;
+};
+
+inline std::string SGWeightTypeName(uint8_t weight_type) {
+  switch (weight_type) {
+    case kSGUnweighted: return "unweighted";
+    case kSGInt32:      return "int32";
+    case kSGFloat:      return "float";
+    case kSGDouble:     return "double";
+    case kSGUInt16:     return "uint16";
+    case kSGUInt8:      return "uint8";
+    default:            return "unknown";
+  }
+}
+
+// Whether every FromT_ value is also a ToT_ value (e.g. uint8 to int32 or
+// float to double, but not int32 to float or anything to uint8)
+template <typename FromT_, typename ToT_>
+struct SGWeightWidens {
+  typedef std::numeric_limits<FromT_> From;
+  typedef std::numeric_limits<ToT_> To;
+  static const bool value =
+      (!From::is_integer && !To::is_integer && (To::digits >= From::digits)) ||
+      (From::is_integer && !To::is_integer && (To::digits >= From::digits)) ||
+      (From::is_integer && To::is_integer && (To::digits >= From::digits) &&
+       (To::is_signed || !From::is_signed));
+};
+
+// Whether w converts to ToT_ without changing (in range, and whole if ToT_ is
+// an integer). Every weight type is exact as a double, so checks are done
+// there rather than risking an out-of-range conversion.
+template <typename ToT_, typename FromT_>
+bool SGWeightFits(FromT_ w) {
+  typedef std::numeric_limits<ToT_> To;
+  double d = static_cast<double>(w);
+  if (!(d >= static_cast<double>(To::lowest()) &&
+        d <= static_cast<double>(To::max())))
+    return false;
+  if (To::is_integer)
+    return d == std::floor(d);
+  return static_cast<double>(static_cast<ToT_>(w)) == d;
+}
+
+
+struct SGSection {
+  uint64_t offset;    // from start of file, multiple of kSGAlignment
+  uint64_t bytes;
+  uint64_t checksum;  // only meaningful if kSGChecksums flag set
+};
+
+struct SGHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint8_t id_bytes;
+  uint8_t offset_bytes;
+  uint8_t weight_type;
+  uint8_t weight_bytes;
+  uint32_t neigh_bytes;    // size of one neighbor record (ID + weight)
+  int64_t num_nodes;
+  int64_t num_edges;       // neighbors stored per direction
+  SGSection sections[kSGNumSections];
+
+  bool directed() const { return flags & kSGDirected; }
+  bool has_checksums() const { return flags & kSGChecksums; }
+};
+
+static_assert(std::is_pod<SGHeader>::value, "SGHeader must be raw bytes");
+static_assert(sizeof(SGHeader) <= kSGAlignment, "SGHeader must fit in block");
+
+
+inline uint8_t SGWeightTypeFromName(const std::string &name) {
+  for (uint8_t t = kSGInt32; t <= kSGUInt8; t++)
+    if (name == SGWeightTypeName(t))
+      return t;
+  return kSGUnweighted;
+}
+
+
+inline bool SGHasMagic(const char *buf) {
+  return std::memcmp(buf, kSGMagic, sizeof(kSGMagic)) == 0;
+}
+
+inline uint64_t SGAlignUp(uint64_t pos) {
+  return (pos + kSGAlignment - 1) / kSGAlignment * kSGAlignment;
+}
+
+// Position-dependent sum of mixed words, so it can be reduced in parallel and
+// still detects reordered or shifted data
+inline uint64_t SGChecksum(const char *data, uint64_t bytes) {
+  const int64_t num_words = bytes / sizeof(uint64_t);
+  uint64_t sum = 0;
+  #pragma omp parallel for reduction(+ : sum)
+  for (int64_t i=0; i < num_words; i++) {
+    uint64_t word;
+    std::memcpy(&word, data + i*sizeof(uint64_t), sizeof(uint64_t));
+    sum += Mix64(word + Mix64(i));
+  }
+  uint64_t tail = 0;
+  std::memcpy(&tail, data + num_words*sizeof(uint64_t),
+              bytes - num_words*sizeof(uint64_t));
+  return sum + Mix64(tail + Mix64(num_words)) + bytes;
+}
+
+#endif  // SG_HEADER_H_
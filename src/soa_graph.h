@@ -0,0 +1,298 @@
+// Copyright (c) 2015, The Regents of the University of California (Regents)
+// See LICENSE.txt for license details
+
+#ifndef SOA_GRAPH_H_
+#define SOA_GRAPH_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cinttypes>
+#include <iostream>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "graph.h"
+#include "pvector.h"
+#include "util.h"
+
+
+/*
+GAP Benchmark Suite
+Class:  SoACSRGraph
+
+Weighted graph in CSR format with neighbor IDs and weights in parallel arrays
+(structure of arrays) rather than interleaved NodeWeight's like CSRGraph
+ - Constructed from a weighted CSRGraph (e.g. from a Builder), which it frees
+ - Iterating out_neigh/in_neigh yields NodeWeight (v,w) pairs, so kernels
+   written for a weighted CSRGraph work unchanged
+ - out_ids/in_ids iterate only the IDs, so topology-only traversals don't pull
+   weights through the cache
+ - ReplaceWeights writes the weight arrays directly, scattering to the
+   in-weights by the edge permutation (computed without searches if not given)
+*/
+
+
+template <class NodeID_, class WeightT_, bool MakeInverse = true>
+class SoACSRGraph {
+  typedef NodeWeight<NodeID_, WeightT_> WNode;
+  typedef CSRGraph<NodeID_, WNode, MakeInverse> InterleavedGraph;
+
+  // Yields (v,w) pairs by value from the two parallel arrays
+  class PairIterator {
+    const NodeID_ *id_;
+    const WeightT_ *w_;
+
+   public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef WNode value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const WNode* pointer;
+    typedef WNode reference;
+
+    PairIterator(const NodeID_ *id, const WeightT_ *w) : id_(id), w_(w) {}
+    WNode operator*() const { return WNode(*id_, *w_); }
+    PairIterator& operator++() {
+      id_++;
+      w_++;
+      return *this;
+    }
+    PairIterator& operator--() {
+      id_--;
+      w_--;
+      return *this;
+    }
+    PairIterator& operator+=(difference_type n) {
+      id_ += n;
+      w_ += n;
+      return *this;
+    }
+    PairIterator operator+(difference_type n) const {
+      return PairIterator(id_ + n, w_ + n);
+    }
+    difference_type operator-(const PairIterator &other) const {
+      return id_ - other.id_;
+    }
+    bool operator!=(const PairIterator &other) const {
+      return id_ != other.id_;
+    }
+    bool operator==(const PairIterator &other) const {
+      return id_ == other.id_;
+    }
+    bool operator<(const PairIterator &other) const {
+      return id_ < other.id_;
+    }
+  };
+
+  template <typename IterT_>
+  class Neighborhood {
+    IterT_ begin_;
+    IterT_ end_;
+
+   public:
+    Neighborhood(IterT_ begin, IterT_ end) : begin_(begin), end_(end) {}
+    typedef IterT_ iterator;
+    iterator begin() const { return begin_; }
+    iterator end() const { return end_; }
+  };
+
+ public:
+  typedef WeightT_ WeightT;
+
+  SoACSRGraph() : directed_(false), num_nodes_(-1), num_edges_(-1) {}
+
+  // Splits interleaved graph into ID & weight arrays, releasing g's storage
+  explicit SoACSRGraph(InterleavedGraph &&g)
+      : directed_(g.directed()), num_nodes_(g.num_nodes()),
+        num_edges_(g.num_edges()) {
+    Split(g, false, out_offsets_, out_ids_, out_weights_);
+    if (directed_ && MakeInverse)
+      Split(g, true, in_offsets_, in_ids_, in_weights_);
+    InterleavedGraph to_free(std::move(g));
+  }
+
+  SoACSRGraph(SoACSRGraph &&other) = default;
+  SoACSRGraph& operator=(SoACSRGraph &&other) = default;
+
+  bool directed() const { return directed_; }
+
+  int64_t num_nodes() const { return num_nodes_; }
+
+  int64_t num_edges() const { return num_edges_; }
+
+  int64_t num_edges_directed() const {
+    return directed_ ? num_edges_ : 2 * num_edges_;
+  }
+
+  int64_t out_degree(NodeID_ v) const {
+    return out_offsets_[v + 1] - out_offsets_[v];
+  }
+
+  int64_t in_degree(NodeID_ v) const {
+    static_assert(MakeInverse, "Graph inversion disabled but reading inverse");
+    return in_offsets()[v + 1] - in_offsets()[v];
+  }
+
+  Neighborhood<PairIterator> out_neigh(NodeID_ n) const {
+    return MakePairs(out_offsets_, out_ids_, out_weights_, n);
+  }
+
+  Neighborhood<PairIterator> in_neigh(NodeID_ n) const {
+    static_assert(MakeInverse, "Graph inversion disabled but reading inverse");
+    return MakePairs(in_offsets(), in_ids(), in_weights(), n);
+  }
+
+  Neighborhood<const NodeID_*> out_ids(NodeID_ n) const {
+    return Neighborhood<const NodeID_*>(out_ids_.data() + out_offsets_[n],
+                                        out_ids_.data() + out_offsets_[n+1]);
+  }
+
+  Neighborhood<const NodeID_*> in_ids(NodeID_ n) const {
+    static_assert(MakeInverse, "Graph inversion disabled but reading inverse");
+    return Neighborhood<const NodeID_*>(in_ids().data() + in_offsets()[n],
+                                        in_ids().data() + in_offsets()[n+1]);
+  }
+
+  void PrintStats() const {
+    std::cout << "Graph has " << num_nodes_ << " nodes and " << num_edges_
+              << " ";
+    if (!directed_)
+      std::cout << "un";
+    std::cout << "directed edges for degree: ";
+    std::cout << num_edges_ / num_nodes_ << std::endl;
+  }
+
+  Range<NodeID_> vertices() const { return Range<NodeID_>(num_nodes()); }
+
+  // For each out-edge, index of the same edge among the in-edges (see
+  // CSRGraph::InEdgePermutation), from the ID-only arrays
+  pvector<SGOffset> InEdgePermutation() const {
+    static_assert(MakeInverse, "Graph inversion disabled but reading inverse");
+    if (directed_) {
+      return TransposePermutation(
+          num_nodes_, [this](int64_t u) { return out_offsets_[u]; },
+          [this](SGOffset e) { return out_ids_[e]; },
+          [this](int64_t v) { return in_offsets_[v]; });
+    }
+    const int64_t out_edges = out_ids_.size();
+    pvector<SGOffset> perm(out_edges);
+    #pragma omp parallel for
+    for (int64_t e = 0; e < out_edges; e++)
+      perm[e] = e;
+    return perm;
+  }
+
+  // Same checksum as CSRGraph::TopologyChecksum, so data cached for a graph
+  // file is valid for either layout
+  uint64_t TopologyChecksum() const {
+    const int64_t in_salt = num_nodes_;
+    const int64_t edge_salt = 2 * num_nodes_;
+    const bool has_in = directed_ && MakeInverse;
+    uint64_t sum = 0;
+    #pragma omp parallel for reduction(+ : sum) schedule(dynamic, 1024)
+    for (NodeID_ u = 0; u < num_nodes_; u++) {
+      sum += Mix64(out_degree(u) + Mix64(u));
+      if (has_in)
+        sum += Mix64((in_offsets_[u+1] - in_offsets_[u]) +
+                     Mix64(in_salt + u));
+      for (SGOffset e = out_offsets_[u]; e < out_offsets_[u+1]; e++)
+        sum += Mix64(out_ids_[e] + Mix64(edge_salt + e));
+    }
+    return sum;
+  }
+
+  void ReplaceWeights(const std::vector<WeightT_> &weights) {
+    ReplaceWeights(weights.data(), weights.size());
+  }
+
+  // Copies weights to the out-weight array and (if directed) scatters them to
+  // the in-weight array using perm (computed here if not given)
+  void ReplaceWeights(const WeightT_ *weights, size_t num_weights,
+                      const SGOffset *perm = nullptr) {
+    const int64_t out_edges = out_ids_.size();
+    assert(num_weights == static_cast<size_t>(out_edges) &&
+           "weights vector has incorrect size");
+    #pragma omp parallel for
+    for (int64_t e = 0; e < out_edges; e++)
+      out_weights_[e] = weights[e];
+    if (directed_ && MakeInverse) {
+      pvector<SGOffset> computed_perm;
+      if (perm == nullptr) {
+        computed_perm = InEdgePermutation();
+        perm = computed_perm.data();
+      }
+      #pragma omp parallel for
+      for (int64_t e = 0; e < out_edges; e++)
+        in_weights_[perm[e]] = weights[e];
+    }
+  }
+
+  // Reorders each out-neighborhood by increasing weight (ties by ID)
+  void SortOutNeighsByWeight() {
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (NodeID_ u = 0; u < num_nodes_; u++) {
+      std::vector<std::pair<WeightT_, NodeID_>> neighs;
+      for (SGOffset e = out_offsets_[u]; e < out_offsets_[u+1]; e++)
+        neighs.push_back(std::make_pair(out_weights_[e], out_ids_[e]));
+      std::sort(neighs.begin(), neighs.end());
+      SGOffset e = out_offsets_[u];
+      for (const auto &wn : neighs) {
+        out_weights_[e] = wn.first;
+        out_ids_[e] = wn.second;
+        e++;
+      }
+    }
+  }
+
+ private:
+  static void Split(const InterleavedGraph &g, bool transpose,
+                    pvector<SGOffset> &offsets, pvector<NodeID_> &ids,
+                    pvector<WeightT_> &weights) {
+    offsets = g.VertexOffsets(transpose);
+    const int64_t num_edges = offsets[g.num_nodes()];
+    const WNode *neighs = transpose ? g.in_neigh(0).begin() :
+                                      g.out_neigh(0).begin();
+    ids = pvector<NodeID_>(num_edges);
+    weights = pvector<WeightT_>(num_edges);
+    #pragma omp parallel for
+    for (int64_t e = 0; e < num_edges; e++) {
+      ids[e] = neighs[e].v;
+      weights[e] = neighs[e].w;
+    }
+  }
+
+  static Neighborhood<PairIterator> MakePairs(const pvector<SGOffset> &offsets,
+                                              const pvector<NodeID_> &ids,
+                                              const pvector<WeightT_> &weights,
+                                              NodeID_ n) {
+    return Neighborhood<PairIterator>(
+        PairIterator(ids.data() + offsets[n], weights.data() + offsets[n]),
+        PairIterator(ids.data() + offsets[n+1],
+                     weights.data() + offsets[n+1]));
+  }
+
+  // Undirected graphs only store one direction
+  const pvector<SGOffset>& in_offsets() const {
+    return directed_ ? in_offsets_ : out_offsets_;
+  }
+
+  const pvector<NodeID_>& in_ids() const {
+    return directed_ ? in_ids_ : out_ids_;
+  }
+
+  const pvector<WeightT_>& in_weights() const {
+    return directed_ ? in_weights_ : out_weights_;
+  }
+
+  bool directed_;
+  int64_t num_nodes_;
+  int64_t num_edges_;
+  pvector<SGOffset> out_offsets_;
+  pvector<NodeID_> out_ids_;
+  pvector<WeightT_> out_weights_;
+  pvector<SGOffset> in_offsets_;
+  pvector<NodeID_> in_ids_;
+  pvector<WeightT_> in_weights_;
+};
+
+#endif  // SOA_GRAPH_H_
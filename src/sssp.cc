@@ -1,20 +1,30 @@
 // Copyright (c) 2015, The Regents of the University of California (Regents)
 // See LICENSE.txt for license details
 
+#include <algorithm>
 #include <cinttypes>
+#include <cmath>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <limits>
 #include <queue>
 #include <vector>
 
 #include "benchmark.h"
+#include "bucket_queue.h"
 #include "builder.h"
+#include "chunked_array.h"
 #include "command_line.h"
 #include "graph.h"
 #include "omp.h"
 #include "platform_atomics.h"
 #include "pvector.h"
+#include "radix_heap.h"
+#include "reader.h"
 #include "timer.h"
+#include "work_queue.h"
+#include "writer.h"
 
 /*
 GAP Benchmark Suite
@@ -38,6 +48,11 @@ phase, each thread also votes on what the next bin should be (smallest
 non-empty bin). In the next phase, each thread copies its selected
 thread-local bin into the shared bin.
 
+The shared bin (frontier) and the thread-local bins live in a DeltaStepContext
+that is reused by every trial and source. The frontier is a ChunkedArray, so
+it only occupies memory for the largest bin copied into it, and bins are
+trimmed after each run so a single large run doesn't pin memory.
+
 Once a vertex is added to a bin, it is not removed, even if its distance is
 later updated and, it now appears in a lower bin. We find ignoring vertices if
 their distance is less than the min distance for the current bin removes
@@ -49,6 +64,79 @@ same priority as those in the current shared bin. This optimization greatly
 reduces the number of iterations needed without violating the priority-based
 execution order, leading to significant speedup on large diameter road networks.
 
+The kernel is templated on the graph type, so it can also run on a
+SoACSRGraph (-L) that keeps neighbor IDs and weights in separate arrays.
+
+With -H, neighborhoods are first sorted by weight (SortNeighborhoodsByWeight)
+and DeltaStepLH is used instead. As in classic delta-stepping [1], it only
+relaxes light edges (w < delta, a prefix of the sorted neighborhood) while a
+bin is processed, and it relaxes the heavy edges of the bin's vertices once
+the bin is finished, since they can't lead back into the same bin. Counting
+relaxations (-DCOUNT_RELAX) reports light and heavy ones separately.
+
+With -d auto, delta is picked from a sample of the graph's weights (AutoDelta).
+With -d adapt, delta also doubles during the run whenever the frontier stays
+too small to keep the threads busy for several iterations. Doubling delta
+merges each pair of adjacent bins, and every thread decides to do it in the
+same iteration (from the shared frontier size), so no extra coordination is
+needed beyond halving the shared bin index.
+
+With -K radix, a sequential Dijkstra over a radix heap (RadixDijkstra) is used
+instead, which avoids delta-stepping's barrier per bin when there is little
+parallelism to exploit. By default (-K auto) it is used when running with one
+thread (unless -H or -d adapt ask for delta-stepping), and DeltaStep hands the
+rest of a run over to it once the frontier stays tiny for several iterations
+(e.g. the long tail of a high-diameter graph). Every thread sees the same
+frontier sizes, so they all stop in the same iteration, and the unprocessed
+frontier and bins seed the heap. This is not used with -d adapt, which
+instead grows delta when the frontier is small.
+
+With -K buckets, BucketStep replaces the bins and barriers with a concurrent
+BucketQueue (like Galois' OBIM [4]). Threads push to thread-private chunks per
+bucket, publish full ones to lock-free per-bucket stacks, and each thread
+independently pulls chunks from the lowest non-empty bucket it finds, so no
+thread waits for the others to finish a bucket. Buckets may be processed out
+of order, which costs some redundant relaxations (corrected when a vertex is
+improved again) but none of the per-bucket barriers that dominate on
+high-diameter graphs with many buckets.
+
+The kernels (except DeltaStepLH and the batched, tree, and point-to-point ones)
+are templated on a relaxation policy, so -p can ask for other path problems:
+widest (bottleneck) paths (max, min), or most reliable paths (max, *) with
+weights as edge probabilities. A policy also maps values to keys that never
+decrease along a path, which the bins and heaps order by, so -d is a bin width
+in keys: distance for shortest paths, distance below the heaviest weight for
+widest paths, and -log(reliability) for reliable paths (-d auto samples the
+keys of single edges). Every policy call is inlined, so shortest paths (min, +)
+compile to the same code as before. Shortest paths limited to h edges
+(-p hops:h) don't fit that scheme (a vertex's best value depends on the hops
+used), so HopLimitedSSSP runs h rounds of Bellman-Ford instead. Each policy has
+its own serial verifier.
+
+With -T, the kernels also record each vertex's parent in the shortest-path
+tree. Distance and parent are packed into one 64-bit word (DistParentArray)
+that is lowered with a single CAS, so relaxations stay lock-free and a parent
+always matches the distance it produced. A parent only changes when the
+distance strictly decreases, so zero-weight edges can't form cycles.
+ExtractPath follows the parents back to the source, and the verifier also
+checks the tree.
+
+With -t or -Q, the kernel instead answers point-to-point queries, one at a
+time with a bidirectional Dijkstra (PointToPoint) that stops as soon as the
+two searches prove the best path found is shortest, and optionally (-A k)
+guides both searches with lower bounds from k landmarks (ALT [3]) whose
+distances are precomputed with DeltaStep. Query latency percentiles are
+reported rather than per-trial times.
+
+With -B k, sources are run k at a time by BatchedDeltaStep, so the batch
+shares one traversal. Distances are stored V x k (a vertex's k distances are
+contiguous, so relaxing an edge for many sources touches one cache line). A
+vertex in a bin relaxes only the sources whose distance to it falls in that
+bin and improved since it last relaxed them, and it moves on to the bin of
+its next such distance. This shares the most work when delta is large enough
+for a batch's distances to a vertex to fall in few bins. Throughput is
+reported in sources per second of kernel time.
+
 [1] Ulrich Meyer and Peter Sanders. "δ-stepping: a parallelizable shortest path
     algorithm." Journal of Algorithms, 49(1):114–152, 2003.
 
@@ -56,6 +144,14 @@ execution order, leading to significant speedup on large diameter road networks.
     Shoaib Kamil, Saman Amarasinghe, and Julian Shun. "Optimizing ordered graph
     algorithms with GraphIt." The 18th International Symposium on Code
 Generation and Optimization (CGO), pages 158-170, 2020.
+
+[3] Andrew V. Goldberg and Chris Harrelson. "Computing the shortest path: A*
+    search meets graph theory." Symposium on Discrete Algorithms (SODA),
+    pages 156-165, 2005.
+
+[4] Donald Nguyen, Andrew Lenharth, and Keshav Pingali. "A lightweight
+    infrastructure for graph analytics." Symposium on Operating Systems
+    Principles (SOSP), pages 456-471, 2013.
 */
 
 using namespace std;
@@ -63,36 +159,333 @@ using namespace std;
 const WeightT kDistInf = numeric_limits<WeightT>::max() / 2;
 const size_t kMaxBin = numeric_limits<size_t>::max() / 2;
 const size_t kBinSizeThreshold = 1000;
+const size_t kAdaptMinFrontierPerThread = 256;
+const int kAdaptSmallIters = 4;
+const size_t kTailMaxFrontierPerThread = 64;
+const int kTailTinyIters = 16;
+const size_t kRetainBins = 1 << 10;
+const size_t kRetainBinCapacity = 1 << 16;
+const size_t kMaxBucketPriority = size_t(1) << 30;
+
+
+// Frontier and bins shared by all runs of DeltaStep(LH) on a graph, the work
+// queue that spreads DeltaStep's frontiers, and the buckets for BucketStep
+class DeltaStepContext {
+ public:
+  explicit DeltaStepContext(int64_t max_frontier)
+      : frontier_(max_frontier), bins_(omp_get_max_threads()),
+        settled_(omp_get_max_threads()), work_(omp_get_max_threads()),
+        buckets_(kMaxBucketPriority, omp_get_max_threads()) {}
+
+  ChunkedArray<NodeID>& frontier() { return frontier_; }
+
+  WorkQueue& work() { return work_; }
+
+  BucketQueue<NodeID>& buckets() { return buckets_; }
+
+  vector<vector<NodeID>>& local_bins(int thread) { return bins_[thread]; }
+
+  vector<NodeID>& settled(int thread) { return settled_[thread]; }
+
+  // Releases unusually large bins (called by each thread after a run)
+  void Trim(int thread) {
+    vector<vector<NodeID>> &local_bins = bins_[thread];
+    if (local_bins.size() > kRetainBins)
+      local_bins.resize(kRetainBins);
+    for (vector<NodeID> &bin : local_bins) {
+      if (bin.capacity() > kRetainBinCapacity)
+        vector<NodeID>().swap(bin);
+    }
+    if (settled_[thread].capacity() > kRetainBinCapacity)
+      vector<NodeID>().swap(settled_[thread]);
+  }
+
+ private:
+  ChunkedArray<NodeID> frontier_;
+  vector<vector<vector<NodeID>>> bins_;
+  vector<vector<NodeID>> settled_;
+  WorkQueue work_;
+  BucketQueue<NodeID> buckets_;
+};
+
+// Distance and parent of each vertex packed into one 64-bit word (distance
+// bits high, parent low), so a relaxation updates both with a single CAS and
+// they always agree. Non-negative int32 and float distances order the same as
+// their bit patterns, so words can be compared as integers.
+class DistParentArray {
+  static_assert(sizeof(WeightT) == 4 && sizeof(NodeID) == 4,
+                "packing needs 32-bit distances and IDs");
+
+ public:
+  DistParentArray(int64_t num_nodes, WeightT init_dist)
+      : words_(num_nodes, Pack(init_dist, -1)) {}
+
+  WeightT operator[](NodeID n) const { return Dist(words_[n]); }
+
+  NodeID parent(NodeID n) const { return Parent(words_[n]); }
+
+  // Lowers v's distance to new_dist with parent, returns true if it did
+  bool Update(NodeID v, WeightT new_dist, NodeID parent) {
+    uint64_t old_word = words_[v];
+    uint64_t new_word = Pack(new_dist, parent);
+    while (new_dist < Dist(old_word)) {
+      if (compare_and_swap(words_[v], old_word, new_word))
+        return true;
+      old_word = words_[v];
+    }
+    return false;
+  }
+
+  pvector<WeightT> dists() const {
+    pvector<WeightT> dist(words_.size());
+    #pragma omp parallel for
+    for (size_t n = 0; n < words_.size(); n++)
+      dist[n] = Dist(words_[n]);
+    return dist;
+  }
+
+  pvector<NodeID> parents() const {
+    pvector<NodeID> parent(words_.size());
+    #pragma omp parallel for
+    for (size_t n = 0; n < words_.size(); n++)
+      parent[n] = Parent(words_[n]);
+    return parent;
+  }
+
+ private:
+  static uint64_t Pack(WeightT dist, NodeID parent) {
+    uint32_t dist_bits;
+    memcpy(&dist_bits, &dist, sizeof(dist_bits));
+    return (static_cast<uint64_t>(dist_bits) << 32) |
+           static_cast<uint32_t>(parent);
+  }
+
+  static WeightT Dist(uint64_t word) {
+    uint32_t dist_bits = word >> 32;
+    WeightT dist;
+    memcpy(&dist, &dist_bits, sizeof(dist));
+    return dist;
+  }
+
+  static NodeID Parent(uint64_t word) {
+    return static_cast<NodeID>(static_cast<uint32_t>(word));
+  }
+
+  pvector<uint64_t> words_;
+};
+
+// Relaxation policies (path semirings) the kernels are templated on (-p).
+// Unreached is the value of vertices without a path, Origin the source's,
+// Extend appends an edge to a path, and Better picks between two values. Key
+// maps values to non-negative priorities that never decrease as a path is
+// extended, which is what the bins (and heaps) order vertices by.
+
+// Shortest paths (min, +), the default
+struct ShortestPaths {
+  WeightT Unreached() const { return kDistInf; }
+  WeightT Origin() const { return 0; }
+  WeightT Extend(WeightT d, WeightT w) const { return d + w; }
+  bool Better(WeightT a, WeightT b) const { return a < b; }
+  WeightT Key(WeightT d) const { return d; }
+};
+
+// Widest (bottleneck) paths (max, min), a path's value is its lightest edge
+class WidestPaths {
+ public:
+  explicit WidestPaths(WeightT max_weight) : max_weight_(max_weight) {}
+  WeightT Unreached() const { return 0; }
+  WeightT Origin() const { return kDistInf; }
+  WeightT Extend(WeightT d, WeightT w) const { return min(d, w); }
+  bool Better(WeightT a, WeightT b) const { return a > b; }
+  WeightT Key(WeightT d) const { return max_weight_ - min(d, max_weight_); }
+
+ private:
+  WeightT max_weight_;
+};
+
+// Most reliable paths (max, *), weights are edge success probabilities in
+// (0, 1] (so it needs floating point weights). Keys are -log(d), which add up
+// along a path like shortest-path distances with edge lengths -log(w), so bins
+// of width delta hold reliabilities within a factor of exp(-delta).
+struct ReliablePaths {
+  WeightT Unreached() const { return 0; }
+  WeightT Origin() const { return 1; }
+  WeightT Extend(WeightT d, WeightT w) const { return d * w; }
+  bool Better(WeightT a, WeightT b) const { return a > b; }
+  WeightT Key(WeightT d) const {
+    return d < 1 ? static_cast<WeightT>(-log(d)) : 0;  // not -0 for radix heap
+  }
+};
+
+// Improves dist[v] to new_dist (atomically), returns true if it did.
+// Overloaded so the kernels can also record parents in a DistParentArray
+// (only for shortest paths).
+template <typename PolicyT_>
+inline bool UpdateDist(pvector<WeightT> &dist, NodeID v, WeightT new_dist,
+                       NodeID, const PolicyT_ &policy) {
+  WeightT old_dist = dist[v];
+  while (policy.Better(new_dist, old_dist)) {
+    if (compare_and_swap(dist[v], old_dist, new_dist))
+      return true;
+    old_dist = dist[v]; // swap failed, recheck dist update & retry
+  }
+  return false;
+}
+
+inline bool UpdateDist(DistParentArray &dist, NodeID v, WeightT new_dist,
+                       NodeID parent, const ShortestPaths &) {
+  return dist.Update(v, new_dist, parent);
+}
+
+inline bool UpdateDist(pvector<WeightT> &dist, NodeID v, WeightT new_dist,
+                       NodeID parent) {
+  return UpdateDist(dist, v, new_dist, parent, ShortestPaths());
+}
+
+inline bool UpdateDist(DistParentArray &dist, NodeID v, WeightT new_dist,
+                       NodeID parent) {
+  return dist.Update(v, new_dist, parent);
+}
+
+// Relaxes the edges [begin, end) of u's neighborhood
+template <typename IterT_, typename DistT_, typename PolicyT_>
+inline void RelaxEdgeRange(NodeID u, IterT_ begin, IterT_ end, WeightT delta,
+                           DistT_ &dist, const PolicyT_ &policy,
+                           vector<vector<NodeID>> &local_bins
+#ifdef COUNT_RELAX
+                           ,
+                           size_t &visits
+#endif
+) {
+  for (IterT_ it = begin; it != end; ++it) {
+    WNode wn = *it;
+#ifdef COUNT_RELAX
+    visits++;
+#endif
+    WeightT new_dist = policy.Extend(dist[u], wn.w);
+    if (UpdateDist(dist, wn.v, new_dist, u, policy)) {
+      size_t dest_bin = policy.Key(new_dist) / delta;
+      if (dest_bin >= local_bins.size())
+        local_bins.resize(dest_bin + 1);
+      local_bins[dest_bin].push_back(wn.v);
+    }
+  }
+}
 
-inline void RelaxEdges(const WGraph &g, NodeID u, WeightT delta,
-                       pvector<WeightT> &dist,
+template <typename WGraphT_, typename DistT_, typename PolicyT_>
+inline void RelaxEdges(const WGraphT_ &g, NodeID u, WeightT delta,
+                       DistT_ &dist, const PolicyT_ &policy,
                        vector<vector<NodeID>> &local_bins
 #ifdef COUNT_RELAX
                        ,
                        size_t &visits
 #endif
 ) {
-  for (WNode wn : g.out_neigh(u)) {
+  RelaxEdgeRange(u, g.out_neigh(u).begin(), g.out_neigh(u).end(), delta, dist,
+                 policy, local_bins
 #ifdef COUNT_RELAX
-    visits++;
+                 ,
+                 visits
 #endif
-    WeightT old_dist = dist[wn.v];
-    WeightT new_dist = dist[u] + wn.w;
-    while (new_dist < old_dist) {
-      if (compare_and_swap(dist[wn.v], old_dist, new_dist)) {
-        size_t dest_bin = new_dist / delta;
-        if (dest_bin >= local_bins.size())
-          local_bins.resize(dest_bin + 1);
-        local_bins[dest_bin].push_back(wn.v);
-        break;
-      }
-      old_dist = dist[wn.v]; // swap failed, recheck dist update & retry
+  );
+}
+
+// Bin i holds distances [i*delta, (i+1)*delta), so after doubling delta it
+// belongs in bin i/2
+inline void MergeBinPairs(vector<vector<NodeID>> &local_bins) {
+  for (size_t i = 1; i < local_bins.size(); i++) {
+    local_bins[i / 2].insert(local_bins[i / 2].end(), local_bins[i].begin(),
+                             local_bins[i].end());
+    local_bins[i].resize(0);
+  }
+  local_bins.resize((local_bins.size() + 1) / 2);
+}
+
+// Settles vertices in order of distance (key) from a heap holding (key,
+// vertex) entries, skipping entries made stale by a later improvement
+template <typename WGraphT_, typename DistT_, typename PolicyT_>
+void RelaxFromHeap(const WGraphT_ &g, DistT_ &dist, const PolicyT_ &policy,
+                   RadixHeap<WeightT, NodeID> &heap
+#ifdef COUNT_RELAX
+                   ,
+                   size_t &visits
+#endif
+) {
+  while (!heap.empty()) {
+    pair<WeightT, NodeID> top = heap.pop();
+    NodeID u = top.second;
+    if (top.first != policy.Key(dist[u]))
+      continue;
+    for (WNode wn : g.out_neigh(u)) {
+#ifdef COUNT_RELAX
+      visits++;
+#endif
+      WeightT new_dist = policy.Extend(dist[u], wn.w);
+      if (UpdateDist(dist, wn.v, new_dist, u, policy))
+        heap.push(policy.Key(new_dist), wn.v);
     }
   }
 }
 
-pvector<WeightT> DeltaStep(const WGraph &g, NodeID source, WeightT delta,
-                           bool logging_enabled = false) {
+// Sequential Dijkstra with a radix heap, which has no barriers or atomics
+// contention, so it beats delta-stepping with one thread or on inputs that
+// expose little parallelism (-K radix)
+template <typename WGraphT_, typename DistT_ = pvector<WeightT>,
+          typename PolicyT_ = ShortestPaths>
+DistT_ RadixDijkstra(const WGraphT_ &g, NodeID source,
+                     const PolicyT_ &policy = PolicyT_()) {
+  DistT_ dist(g.num_nodes(), policy.Unreached());
+  UpdateDist(dist, source, policy.Origin(), source, policy);
+  RadixHeap<WeightT, NodeID> heap;
+  heap.push(policy.Key(policy.Origin()), source);
+#ifdef COUNT_RELAX
+  size_t visits = 0;
+  RelaxFromHeap(g, dist, policy, heap, visits);
+  cout << "Number of relaxations: " << visits << endl;
+#else
+  RelaxFromHeap(g, dist, policy, heap);
+#endif
+  return dist;
+}
+
+// Finishes a DeltaStep run sequentially once its frontier has stayed tiny,
+// starting from the unprocessed shared bin and every thread's local bins
+template <typename WGraphT_, typename DistT_, typename PolicyT_>
+void FinishWithRadixHeap(const WGraphT_ &g, DistT_ &dist,
+                         const PolicyT_ &policy, DeltaStepContext &ctx,
+                         size_t frontier_tail, WeightT lower
+#ifdef COUNT_RELAX
+                         ,
+                         size_t &visits
+#endif
+) {
+  RadixHeap<WeightT, NodeID> heap;
+  ChunkedArray<NodeID> &frontier = ctx.frontier();
+  for (size_t i = 0; i < frontier_tail; i++) {
+    if (policy.Key(dist[frontier[i]]) >= lower)
+      heap.push(policy.Key(dist[frontier[i]]), frontier[i]);
+  }
+  for (int thread = 0; thread < omp_get_max_threads(); thread++) {
+    for (vector<NodeID> &bin : ctx.local_bins(thread)) {
+      for (NodeID u : bin)
+        heap.push(policy.Key(dist[u]), u);
+      bin.resize(0);
+    }
+  }
+  RelaxFromHeap(g, dist, policy, heap
+#ifdef COUNT_RELAX
+                ,
+                visits
+#endif
+  );
+}
+
+template <typename WGraphT_, typename DistT_ = pvector<WeightT>,
+          typename PolicyT_ = ShortestPaths>
+DistT_ DeltaStep(const WGraphT_ &g, NodeID source, WeightT delta,
+                 DeltaStepContext &ctx, bool logging_enabled = false,
+                 bool adapt_delta = false, bool serial_tail = false,
+                 const PolicyT_ &policy = PolicyT_()) {
   Timer t;
 #ifdef COUNT_RELAX
   size_t total_visits = 0;
@@ -103,9 +496,10 @@ pvector<WeightT> DeltaStep(const WGraph &g, NodeID source, WeightT delta,
   double total_copy_time = 0;
   double total_barriers_time = 0;
 #endif
-  pvector<WeightT> dist(g.num_nodes(), kDistInf);
-  dist[source] = 0;
-  pvector<NodeID> frontier(g.num_edges_directed());
+  DistT_ dist(g.num_nodes(), policy.Unreached());
+  UpdateDist(dist, source, policy.Origin(), source, policy);
+  ChunkedArray<NodeID> &frontier = ctx.frontier();
+  frontier.Reserve(0, 1);
   // two element arrays for double buffering curr=iter&1, next=(iter+1)&1
   size_t shared_indexes[2] = {0, kMaxBin};
   size_t frontier_tails[2] = {1, 0};
@@ -113,33 +507,72 @@ pvector<WeightT> DeltaStep(const WGraph &g, NodeID source, WeightT delta,
   t.Start();
 #pragma omp parallel
   {
+#pragma omp single
+    ctx.work().Reset(omp_get_num_threads());
 #ifdef COUNT_RELAX
     size_t visits = 0;
 #endif
 #ifdef COUNT_TIME
     CumulativeTimer cb_t, bf_t, cp_t, bs_t;
 #endif
-    vector<vector<NodeID>> local_bins(0);
+    vector<vector<NodeID>> &local_bins = ctx.local_bins(omp_get_thread_num());
     size_t iter = 0;
+    WeightT thread_delta = delta;
+    int small_iters = 0;
+    int tiny_iters = 0;
+    size_t peak_frontier = 0;
     while (shared_indexes[iter & 1] != kMaxBin) {
       size_t &curr_bin_index = shared_indexes[iter & 1];
       size_t &next_bin_index = shared_indexes[(iter + 1) & 1];
       size_t &curr_frontier_tail = frontier_tails[iter & 1];
       size_t &next_frontier_tail = frontier_tails[(iter + 1) & 1];
+      if (serial_tail) {
+        // tiny: can't occupy every thread, or small and well past its peak
+        size_t num_threads = omp_get_num_threads();
+        peak_frontier = max(peak_frontier, curr_frontier_tail);
+        bool tiny = (curr_frontier_tail < num_threads) ||
+                    ((curr_frontier_tail < kTailMaxFrontierPerThread *
+                                           num_threads) &&
+                     (curr_frontier_tail * 4 < peak_frontier));
+        tiny_iters = tiny ? tiny_iters + 1 : 0;
+        if (tiny_iters == kTailTinyIters)  // same for all threads
+          break;
+      }
+      if (adapt_delta && (thread_delta < kDistInf / 4)) {
+        size_t min_frontier =
+            kAdaptMinFrontierPerThread * omp_get_num_threads();
+        small_iters = curr_frontier_tail < min_frontier ? small_iters + 1 : 0;
+        if (small_iters == kAdaptSmallIters) {  // same for all threads
+          small_iters = 0;
+          thread_delta *= 2;
+          MergeBinPairs(local_bins);
+#pragma omp single
+          {
+            curr_bin_index /= 2;
+            if (logging_enabled)
+              cout << "delta doubled to " << thread_delta << endl;
+          }
+        }
+      }
 #ifdef COUNT_TIME
       cb_t.Start();
 #endif
-#pragma omp for nowait schedule(dynamic, 64)
-      for (size_t i = 0; i < curr_frontier_tail; i++) {
+      ctx.work().Run(omp_get_thread_num(), omp_get_num_threads(),
+                     curr_frontier_tail,
+                     [&](int64_t i) { return g.out_degree(frontier[i]); },
+                     [&](int64_t i, int64_t begin, int64_t end) {
         NodeID u = frontier[i];
-        if (dist[u] >= delta * static_cast<WeightT>(curr_bin_index))
-          RelaxEdges(g, u, delta, dist, local_bins
+        if (policy.Key(dist[u]) >=
+            thread_delta * static_cast<WeightT>(curr_bin_index))
+          RelaxEdgeRange(u, g.out_neigh(u).begin() + begin,
+                         g.out_neigh(u).begin() + end, thread_delta, dist,
+                         policy, local_bins
 #ifdef COUNT_RELAX
-                     ,
-                     visits
+                         ,
+                         visits
 #endif
           );
-      }
+      });
 #ifdef COUNT_TIME
       cb_t.Stop();
       bf_t.Start();
@@ -151,7 +584,7 @@ pvector<WeightT> DeltaStep(const WGraph &g, NodeID source, WeightT delta,
         vector<NodeID> curr_bin_copy = local_bins[curr_bin_index];
         local_bins[curr_bin_index].resize(0);
         for (NodeID u : curr_bin_copy)
-          RelaxEdges(g, u, delta, dist, local_bins
+          RelaxEdges(g, u, thread_delta, dist, policy, local_bins
 #ifdef COUNT_RELAX
                      ,
                      visits
@@ -187,8 +620,8 @@ pvector<WeightT> DeltaStep(const WGraph &g, NodeID source, WeightT delta,
       if (next_bin_index < local_bins.size()) {
         size_t copy_start = fetch_and_add(next_frontier_tail,
                                           local_bins[next_bin_index].size());
-        copy(local_bins[next_bin_index].begin(),
-             local_bins[next_bin_index].end(), frontier.data() + copy_start);
+        frontier.CopyIn(copy_start, local_bins[next_bin_index].begin(),
+                        local_bins[next_bin_index].end());
         local_bins[next_bin_index].resize(0);
       }
       iter++;
@@ -203,6 +636,23 @@ pvector<WeightT> DeltaStep(const WGraph &g, NodeID source, WeightT delta,
       bs_t.Stop();
 #endif
     } //////////////////// end while : sssp finished
+    if (tiny_iters == kTailTinyIters) {
+#pragma omp single
+      {
+        if (logging_enabled)
+          cout << "finishing serially from bin " << shared_indexes[iter & 1]
+               << endl;
+        FinishWithRadixHeap(g, dist, policy, ctx, frontier_tails[iter & 1],
+                            thread_delta *
+                            static_cast<WeightT>(shared_indexes[iter & 1])
+#ifdef COUNT_RELAX
+                            ,
+                            visits
+#endif
+        );
+      }
+    }
+    ctx.Trim(omp_get_thread_num());
 #ifdef COUNT_RELAX
 #pragma omp atomic
     total_visits += visits;
@@ -222,8 +672,13 @@ pvector<WeightT> DeltaStep(const WGraph &g, NodeID source, WeightT delta,
 
 #endif
 #pragma omp single
-    if (logging_enabled)
+    if (logging_enabled) {
       cout << "took " << iter << " iterations" << endl;
+      cout << "frontier holds " << frontier.allocated_bytes() << " bytes"
+           << endl;
+      if (adapt_delta)
+        cout << "final delta " << thread_delta << endl;
+    }
   }
 #ifdef COUNT_RELAX
   cout << "Number of relaxations: " << total_visits << endl;
@@ -244,85 +699,1449 @@ pvector<WeightT> DeltaStep(const WGraph &g, NodeID source, WeightT delta,
   return dist;
 }
 
-void PrintSSSPStats(const WGraph &g, const pvector<WeightT> &dist) {
-  WeightT max_dist = 0;
-  int64_t num_reached = 0;
+// Neighborhoods must be sorted by weight, so the heavy edges follow the split
+template <typename WGraphT_>
+inline auto LightEnd(const WGraphT_ &g, NodeID u, WeightT delta)
+    -> decltype(g.out_neigh(u).begin()) {
+  return lower_bound(g.out_neigh(u).begin(), g.out_neigh(u).end(), delta,
+                     [](const WNode &wn, WeightT d) { return wn.w < d; });
+}
 
-#pragma omp parallel for reduction(+ : num_reached) reduction(max : max_dist)
-  for (size_t i = 0; i < dist.size(); i++) {
-    if (dist[i] != kDistInf && dist[i] > max_dist)
-      max_dist = dist[i];
-    if (dist[i] != kDistInf)
-      num_reached++;
+// Same bin structure as DeltaStep, but vertices are added to settled when
+// processed, and once every thread agrees the current bin is finished
+// (voted next bin is higher), their heavy edges are relaxed and the next bin
+// is voted on again
+template <typename WGraphT_, typename DistT_ = pvector<WeightT>>
+DistT_ DeltaStepLH(const WGraphT_ &g, NodeID source, WeightT delta,
+                   DeltaStepContext &ctx, bool logging_enabled = false) {
+  Timer t;
+#ifdef COUNT_RELAX
+  size_t total_light = 0, total_heavy = 0;
+#endif
+  DistT_ dist(g.num_nodes(), kDistInf);
+  UpdateDist(dist, source, 0, source);
+  ChunkedArray<NodeID> &frontier = ctx.frontier();
+  frontier.Reserve(0, 1);
+  size_t shared_indexes[2] = {0, kMaxBin};
+  size_t frontier_tails[2] = {1, 0};
+  frontier[0] = source;
+  t.Start();
+#pragma omp parallel
+  {
+#ifdef COUNT_RELAX
+    size_t light_visits = 0, heavy_visits = 0;
+#endif
+    vector<vector<NodeID>> &local_bins = ctx.local_bins(omp_get_thread_num());
+    vector<NodeID> &settled = ctx.settled(omp_get_thread_num());
+    size_t iter = 0;
+    while (shared_indexes[iter & 1] != kMaxBin) {
+      size_t &curr_bin_index = shared_indexes[iter & 1];
+      size_t &next_bin_index = shared_indexes[(iter + 1) & 1];
+      size_t &curr_frontier_tail = frontier_tails[iter & 1];
+      size_t &next_frontier_tail = frontier_tails[(iter + 1) & 1];
+#pragma omp for nowait schedule(dynamic, 64)
+      for (size_t i = 0; i < curr_frontier_tail; i++) {
+        NodeID u = frontier[i];
+        if (dist[u] >= delta * static_cast<WeightT>(curr_bin_index)) {
+          RelaxEdgeRange(u, g.out_neigh(u).begin(), LightEnd(g, u, delta),
+                         delta, dist, ShortestPaths(), local_bins
+#ifdef COUNT_RELAX
+                         ,
+                         light_visits
+#endif
+          );
+          settled.push_back(u);
+        }
+      }
+      while (curr_bin_index < local_bins.size() &&
+             !local_bins[curr_bin_index].empty() &&
+             local_bins[curr_bin_index].size() < kBinSizeThreshold) {
+        vector<NodeID> curr_bin_copy = local_bins[curr_bin_index];
+        local_bins[curr_bin_index].resize(0);
+        for (NodeID u : curr_bin_copy) {
+          RelaxEdgeRange(u, g.out_neigh(u).begin(), LightEnd(g, u, delta),
+                         delta, dist, ShortestPaths(), local_bins
+#ifdef COUNT_RELAX
+                         ,
+                         light_visits
+#endif
+          );
+          settled.push_back(u);
+        }
+      }
+      for (size_t i = curr_bin_index; i < local_bins.size(); i++) {
+        if (!local_bins[i].empty()) {
+#pragma omp critical
+          next_bin_index = min(next_bin_index, i);
+          break;
+        }
+      }
+#pragma omp barrier
+      if (next_bin_index != curr_bin_index) {  // bin finished, dists final
+        sort(settled.begin(), settled.end());
+        settled.erase(unique(settled.begin(), settled.end()), settled.end());
+        for (NodeID u : settled)
+          RelaxEdgeRange(u, LightEnd(g, u, delta), g.out_neigh(u).end(),
+                         delta, dist, ShortestPaths(), local_bins
+#ifdef COUNT_RELAX
+                         ,
+                         heavy_visits
+#endif
+          );
+        settled.resize(0);
+#pragma omp barrier
+#pragma omp single
+        next_bin_index = kMaxBin;
+        for (size_t i = curr_bin_index + 1; i < local_bins.size(); i++) {
+          if (!local_bins[i].empty()) {
+#pragma omp critical
+            next_bin_index = min(next_bin_index, i);
+            break;
+          }
+        }
+#pragma omp barrier
+      }
+#pragma omp single nowait
+      {
+        t.Stop();
+        if (logging_enabled)
+          PrintStep(curr_bin_index, t.Millisecs(), curr_frontier_tail);
+        t.Start();
+        curr_bin_index = kMaxBin;
+        curr_frontier_tail = 0;
+      }
+      if (next_bin_index < local_bins.size()) {
+        size_t copy_start = fetch_and_add(next_frontier_tail,
+                                          local_bins[next_bin_index].size());
+        frontier.CopyIn(copy_start, local_bins[next_bin_index].begin(),
+                        local_bins[next_bin_index].end());
+        local_bins[next_bin_index].resize(0);
+      }
+      iter++;
+#pragma omp barrier
+    }
+    ctx.Trim(omp_get_thread_num());
+#ifdef COUNT_RELAX
+#pragma omp atomic
+    total_light += light_visits;
+#pragma omp atomic
+    total_heavy += heavy_visits;
+#endif
+#pragma omp single
+    if (logging_enabled) {
+      cout << "took " << iter << " iterations" << endl;
+      cout << "frontier holds " << frontier.allocated_bytes() << " bytes"
+           << endl;
+    }
   }
-
-  cout << "SSSP Tree reaches " << num_reached << " nodes" << endl;
-  cout << "Max dist " << max_dist << endl;
+#ifdef COUNT_RELAX
+  cout << "Number of relaxations: " << total_light + total_heavy << " ("
+       << total_light << " light, " << total_heavy << " heavy)" << endl;
+#endif
+  return dist;
 }
 
-// Compares against simple serial implementation
-bool SSSPVerifier(const WGraph &g, NodeID source,
-                  const pvector<WeightT> &dist_to_test) {
-  // Serial Dijkstra implementation to get oracle distances
-  pvector<WeightT> oracle_dist(g.num_nodes(), kDistInf);
-  oracle_dist[source] = 0;
-  typedef pair<WeightT, NodeID> WN;
-  priority_queue<WN, vector<WN>, greater<WN>> mq;
-  mq.push(make_pair(0, source));
-  while (!mq.empty()) {
-    WeightT td = mq.top().first;
-    NodeID u = mq.top().second;
-    mq.pop();
-    if (td == oracle_dist[u]) {
-      for (WNode wn : g.out_neigh(u)) {
-        if (td + wn.w < oracle_dist[wn.v]) {
-          oracle_dist[wn.v] = td + wn.w;
-          mq.push(make_pair(td + wn.w, wn.v));
+// Delta-stepping over a BucketQueue (-K buckets): each thread pulls chunks
+// from the lowest bucket it can find and pushes improved vertices to the
+// bucket of their new distance, with no barriers or frontier copies between
+// buckets. Order is relaxed, so a vertex is skipped if its distance has since
+// moved it to a lower bucket (it was pushed there too).
+template <typename WGraphT_, typename DistT_ = pvector<WeightT>,
+          typename PolicyT_ = ShortestPaths>
+DistT_ BucketStep(const WGraphT_ &g, NodeID source, WeightT delta,
+                  DeltaStepContext &ctx, bool logging_enabled = false,
+                  const PolicyT_ &policy = PolicyT_()) {
+  Timer t;
+#ifdef COUNT_RELAX
+  size_t total_visits = 0;
+#endif
+  DistT_ dist(g.num_nodes(), policy.Unreached());
+  UpdateDist(dist, source, policy.Origin(), source, policy);
+  BucketQueue<NodeID> &buckets = ctx.buckets();
+  auto Priority = [delta, &policy](WeightT d) {
+    return static_cast<size_t>(min(policy.Key(d) / delta,
+        static_cast<WeightT>(kMaxBucketPriority)));
+  };
+  size_t total_chunks = 0;
+  t.Start();
+#pragma omp parallel reduction(+ : total_chunks)
+  {
+#ifdef COUNT_RELAX
+    size_t visits = 0;
+#endif
+    const int thread = omp_get_thread_num();
+#pragma omp single
+    {
+      buckets.Start(omp_get_num_threads());
+      buckets.Push(thread, 0, source);
+    }
+    size_t priority = 0;
+    const BucketQueue<NodeID>::Chunk *chunk;
+    while (buckets.Next(thread, priority, chunk)) {
+      total_chunks++;
+      for (NodeID u : *chunk) {
+        if (Priority(dist[u]) != priority)
+          continue;
+        for (WNode wn : g.out_neigh(u)) {
+#ifdef COUNT_RELAX
+          visits++;
+#endif
+          WeightT new_dist = policy.Extend(dist[u], wn.w);
+          if (UpdateDist(dist, wn.v, new_dist, u, policy))
+            buckets.Push(thread, Priority(new_dist), wn.v);
         }
       }
     }
+#ifdef COUNT_RELAX
+#pragma omp atomic
+    total_visits += visits;
+#endif
   }
-  // Report any mismatches
-  bool all_ok = true;
-  for (NodeID n : g.vertices()) {
-    if (dist_to_test[n] != oracle_dist[n]) {
-      cout << n << ": " << dist_to_test[n] << " != " << oracle_dist[n] << endl;
-      all_ok = false;
+  t.Stop();
+  if (logging_enabled)
+    cout << "took " << total_chunks << " chunks in " << t.Millisecs() << " ms"
+         << endl;
+#ifdef COUNT_RELAX
+  cout << "Number of relaxations: " << total_visits << endl;
+#endif
+  return dist;
+}
+
+// Lowers d to new_dist if smaller (atomically), tracking the smallest update
+inline void LowerDist(WeightT &d, WeightT new_dist, WeightT &min_new_dist) {
+  WeightT old_dist = d;
+  while (new_dist < old_dist) {
+    if (compare_and_swap(d, old_dist, new_dist)) {
+      min_new_dist = min(min_new_dist, new_dist);
+      break;
     }
+    old_dist = d;  // swap failed, recheck dist update & retry
   }
-  return all_ok;
 }
 
-int main(int argc, char *argv[]) {
-  CLDelta<WeightT> cli(argc, argv, "single-source shortest-path");
-  if (!cli.ParseArgs())
-    return -1;
-  WeightedBuilder b(cli);
-  WGraph g = b.MakeGraph();
-  g.PrintStats();
-
-  if (cli.weights_filename() != "") {
-    VectorReader<WeightT> reader(cli.weights_filename());
-    auto weights = reader.ReadSerialized();
-    g.ReplaceWeights(weights);
-  }
+// Relaxes u's out-edges for the sources of a batch (dist is V x K) whose
+// distance to u is in the current bin [lower, lower + delta) and has improved
+// since u last relaxed it (relaxed holds those distances, also V x K). If
+// higher distances still need relaxing, u is added to the bin of the smallest
+// one. A neighbor is added once per edge, to the bin of the smallest distance
+// that improved. If most lanes are active, all K are checked with a
+// branch-free (vectorizable) loop before any atomics, otherwise only the
+// active lanes are visited.
+template <typename WGraphT_>
+inline void RelaxEdgesBatch(const WGraphT_ &g, NodeID u, int64_t K,
+                            WeightT lower, WeightT delta,
+                            pvector<WeightT> &dist, pvector<WeightT> &relaxed,
+                            vector<WeightT> &u_dist,
+                            vector<int32_t> &active_lanes,
+                            vector<vector<NodeID>> &local_bins
+#ifdef COUNT_RELAX
+                            ,
+                            size_t &visits
+#endif
+) {
+  const WeightT *du = dist.data() + u * K;
+  WeightT *u_relaxed = relaxed.data() + u * K;
+  const WeightT upper = lower + delta;
+  WeightT min_later_dist = kDistInf;
+  active_lanes.resize(0);
+  for (int64_t k = 0; k < K; k++) {
+    WeightT d = du[k];
+    bool pending = d < u_relaxed[k];
+    bool active = pending && (d >= lower) && (d < upper);
+    u_dist[k] = active ? d : kDistInf;
+    if (active)
+      active_lanes.push_back(k);
+    if (pending && (d >= upper))
+      min_later_dist = min(min_later_dist, d);
+  }
+  if (min_later_dist != kDistInf) {
+    size_t later_bin = min_later_dist / delta;
+    if (later_bin >= local_bins.size())
+      local_bins.resize(later_bin + 1);
+    local_bins[later_bin].push_back(u);
+  }
+  if (active_lanes.empty())
+    return;
+  for (int32_t k : active_lanes)
+    u_relaxed[k] = u_dist[k];
+  const bool dense = static_cast<int64_t>(active_lanes.size()) * 2 >= K;
+  for (WNode wn : g.out_neigh(u)) {
+#ifdef COUNT_RELAX
+    visits++;
+#endif
+    WeightT *dv = dist.data() + wn.v * K;
+    WeightT min_new_dist = kDistInf;
+    if (dense) {
+      int improves = 0;
+      for (int64_t k = 0; k < K; k++)
+        improves |= u_dist[k] + wn.w < dv[k];
+      if (!improves)
+        continue;
+      for (int64_t k = 0; k < K; k++)
+        LowerDist(dv[k], u_dist[k] + wn.w, min_new_dist);
+    } else {
+      for (int32_t k : active_lanes)
+        LowerDist(dv[k], u_dist[k] + wn.w, min_new_dist);
+    }
+    if (min_new_dist != kDistInf) {
+      size_t dest_bin = min_new_dist / delta;
+      if (dest_bin >= local_bins.size())
+        local_bins.resize(dest_bin + 1);
+      local_bins[dest_bin].push_back(wn.v);
+    }
+  }
+}
+
+// Delta-stepping from all of sources at once, returns V x K distances
+// (dist[v*K + k] is the distance from sources[k] to v)
+template <typename WGraphT_>
+pvector<WeightT> BatchedDeltaStep(const WGraphT_ &g,
+                                  const vector<NodeID> &sources,
+                                  WeightT delta, DeltaStepContext &ctx,
+                                  bool logging_enabled = false) {
+  Timer t;
+#ifdef COUNT_RELAX
+  size_t total_visits = 0;
+#endif
+  const int64_t K = sources.size();
+  pvector<WeightT> dist(g.num_nodes() * K, kDistInf);
+  pvector<WeightT> relaxed(g.num_nodes() * K, kDistInf);
+  ChunkedArray<NodeID> &frontier = ctx.frontier();
+  frontier.Reserve(0, K);
+  for (int64_t k = 0; k < K; k++) {
+    dist[sources[k] * K + k] = 0;
+    frontier[k] = sources[k];
+  }
+  size_t shared_indexes[2] = {0, kMaxBin};
+  size_t frontier_tails[2] = {static_cast<size_t>(K), 0};
+  t.Start();
+#pragma omp parallel
+  {
+#ifdef COUNT_RELAX
+    size_t visits = 0;
+#endif
+    vector<vector<NodeID>> &local_bins = ctx.local_bins(omp_get_thread_num());
+    vector<WeightT> u_dist(K);
+    vector<int32_t> active_lanes;
+    active_lanes.reserve(K);
+    size_t iter = 0;
+    while (shared_indexes[iter & 1] != kMaxBin) {
+      size_t &curr_bin_index = shared_indexes[iter & 1];
+      size_t &next_bin_index = shared_indexes[(iter + 1) & 1];
+      size_t &curr_frontier_tail = frontier_tails[iter & 1];
+      size_t &next_frontier_tail = frontier_tails[(iter + 1) & 1];
+      WeightT lower = delta * static_cast<WeightT>(curr_bin_index);
+#pragma omp for nowait schedule(dynamic, 64)
+      for (size_t i = 0; i < curr_frontier_tail; i++)
+        RelaxEdgesBatch(g, frontier[i], K, lower, delta, dist, relaxed,
+                        u_dist, active_lanes, local_bins
+#ifdef COUNT_RELAX
+                        ,
+                        visits
+#endif
+        );
+      while (curr_bin_index < local_bins.size() &&
+             !local_bins[curr_bin_index].empty() &&
+             local_bins[curr_bin_index].size() < kBinSizeThreshold) {
+        vector<NodeID> curr_bin_copy = local_bins[curr_bin_index];
+        local_bins[curr_bin_index].resize(0);
+        for (NodeID u : curr_bin_copy)
+          RelaxEdgesBatch(g, u, K, lower, delta, dist, relaxed, u_dist,
+                          active_lanes, local_bins
+#ifdef COUNT_RELAX
+                          ,
+                          visits
+#endif
+          );
+      }
+      for (size_t i = curr_bin_index; i < local_bins.size(); i++) {
+        if (!local_bins[i].empty()) {
+#pragma omp critical
+          next_bin_index = min(next_bin_index, i);
+          break;
+        }
+      }
+#pragma omp barrier
+#pragma omp single nowait
+      {
+        t.Stop();
+        if (logging_enabled)
+          PrintStep(curr_bin_index, t.Millisecs(), curr_frontier_tail);
+        t.Start();
+        curr_bin_index = kMaxBin;
+        curr_frontier_tail = 0;
+      }
+      if (next_bin_index < local_bins.size()) {
+        size_t copy_start = fetch_and_add(next_frontier_tail,
+                                          local_bins[next_bin_index].size());
+        frontier.CopyIn(copy_start, local_bins[next_bin_index].begin(),
+                        local_bins[next_bin_index].end());
+        local_bins[next_bin_index].resize(0);
+      }
+      iter++;
+#pragma omp barrier
+    }
+    ctx.Trim(omp_get_thread_num());
+#ifdef COUNT_RELAX
+#pragma omp atomic
+    total_visits += visits;
+#endif
+#pragma omp single
+    if (logging_enabled) {
+      cout << "took " << iter << " iterations" << endl;
+      cout << "frontier holds " << frontier.allocated_bytes() << " bytes"
+           << endl;
+    }
+  }
+#ifdef COUNT_RELAX
+  cout << "Number of relaxations: " << total_visits << endl;
+#endif
+  return dist;
+}
+
+// Orders each out-neighborhood by increasing weight (for DeltaStepLH)
+inline void SortNeighborhoodsByWeight(WGraph &g) {
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (NodeID u = 0; u < g.num_nodes(); u++)
+    sort(g.out_neigh(u).begin(), g.out_neigh(u).end(),
+         [](const WNode &a, const WNode &b) {
+           return a.w == b.w ? a.v < b.v : a.w < b.w;
+         });
+}
+
+inline void SortNeighborhoodsByWeight(SoAWGraph &g) {
+  g.SortOutNeighsByWeight();
+}
+
+// Picks delta so that on average about one out-edge per vertex is light
+// (w < delta), i.e. the 1/(average degree) quantile of a sample of weights
+// taken from vertices spread across the graph. Under other policies, the
+// sample is of edges' keys (the key of a path of just that edge), since delta
+// is a width in keys.
+template <typename WGraphT_, typename PolicyT_ = ShortestPaths>
+WeightT AutoDelta(const WGraphT_ &g, const PolicyT_ &policy = PolicyT_()) {
+  const int64_t kMaxSampleNodes = 1 << 14;
+  const int64_t kMaxSamplesPerNode = 8;
+  vector<WeightT> samples;
+  int64_t stride = max(g.num_nodes() / kMaxSampleNodes, int64_t(1));
+  for (int64_t u = 0; u < g.num_nodes(); u += stride) {
+    int64_t taken = 0;
+    for (WNode wn : g.out_neigh(u)) {
+      if (taken++ == kMaxSamplesPerNode)
+        break;
+      samples.push_back(policy.Key(policy.Extend(policy.Origin(), wn.w)));
+    }
+  }
+  sort(samples.begin(), samples.end());
+  double avg_degree = static_cast<double>(g.num_edges_directed()) /
+                      max(g.num_nodes(), int64_t(1));
+  double quantile = min(1.0, 1 / max(avg_degree, 1.0));
+  size_t i = quantile * (samples.size() - 1);
+  while ((i < samples.size()) && (samples[i] <= 0))
+    i++;
+  return i < samples.size() ? samples[i] : 1;
+}
+
+template <typename WGraphT_>
+void PrintSSSPStats(const WGraphT_ &g, const pvector<WeightT> &dist) {
+  WeightT max_dist = 0;
+  int64_t num_reached = 0;
+
+#pragma omp parallel for reduction(+ : num_reached) reduction(max : max_dist)
+  for (size_t i = 0; i < dist.size(); i++) {
+    if (dist[i] != kDistInf && dist[i] > max_dist)
+      max_dist = dist[i];
+    if (dist[i] != kDistInf)
+      num_reached++;
+  }
+
+  cout << "SSSP Tree reaches " << num_reached << " nodes" << endl;
+  cout << "Max dist " << max_dist << endl;
+}
+
+// Vertices on the shortest path from the source (the vertex that is its own
+// parent) to target, empty if target wasn't reached
+inline vector<NodeID> ExtractPath(const pvector<NodeID> &parent,
+                                  NodeID target) {
+  vector<NodeID> path;
+  if (parent[target] == -1)
+    return path;
+  for (NodeID v = target; path.size() < parent.size(); v = parent[v]) {
+    path.push_back(v);
+    if (parent[v] == v)
+      break;
+  }
+  reverse(path.begin(), path.end());
+  return path;
+}
+
+template <typename WGraphT_>
+void PrintSSSPTreeStats(const WGraphT_ &g, const DistParentArray &tree) {
+  const size_t kMaxPrintedPath = 16;
+  pvector<WeightT> dist = tree.dists();
+  PrintSSSPStats(g, dist);
+  // vertex 0 may be unreached, so start from the first reached vertex
+  NodeID farthest = -1;
+  for (NodeID n : g.vertices()) {
+    if (dist[n] != kDistInf && (farthest == -1 || dist[n] > dist[farthest]))
+      farthest = n;
+  }
+  if (farthest == -1)
+    return;
+  vector<NodeID> path = ExtractPath(tree.parents(), farthest);
+  if (path.empty())
+    return;
+  cout << "Path to " << farthest << " has " << path.size() - 1 << " hops";
+  if (path.size() <= kMaxPrintedPath) {
+    cout << ":";
+    for (NodeID v : path)
+      cout << " " << v;
+  }
+  cout << endl;
+}
+
+// Checks parent is a shortest-path tree for dist: the source is its own
+// parent, unreached vertices have none, each other vertex is reached from its
+// parent by an edge that accounts for its distance, and following parents
+// leads back to the source
+template <typename WGraphT_>
+bool VerifyParents(const WGraphT_ &g, NodeID source,
+                   const pvector<WeightT> &dist,
+                   const pvector<NodeID> &parent) {
+  bool all_ok = true;
+  if (parent[source] != source) {
+    cout << source << ": source has parent " << parent[source] << endl;
+    all_ok = false;
+  }
+  #pragma omp parallel for reduction(&& : all_ok) schedule(dynamic, 1024)
+  for (NodeID v = 0; v < g.num_nodes(); v++) {
+    if (v == source)
+      continue;
+    NodeID p = parent[v];
+    if (dist[v] == kDistInf) {
+      if (p != -1) {
+        #pragma omp critical
+        cout << v << ": unreached but has parent " << p << endl;
+        all_ok = false;
+      }
+      continue;
+    }
+    bool tree_edge = false;
+    if ((p >= 0) && (p < g.num_nodes())) {
+      for (WNode wn : g.out_neigh(p)) {
+        if ((wn.v == v) && (dist[p] + wn.w == dist[v])) {
+          tree_edge = true;
+          break;
+        }
+      }
+    }
+    if (!tree_edge) {
+      #pragma omp critical
+      cout << v << ": parent " << p << " not on a shortest path" << endl;
+      all_ok = false;
+    }
+  }
+  if (!all_ok)
+    return false;
+  // Walk up from each vertex until reaching one known to lead to the source
+  enum WalkState : uint8_t { kUnknown, kOnWalk, kReachesSource };
+  vector<WalkState> state(g.num_nodes(), kUnknown);
+  state[source] = kReachesSource;
+  vector<NodeID> walk;
+  for (NodeID v : g.vertices()) {
+    if (dist[v] == kDistInf)
+      continue;
+    NodeID u = v;
+    while (state[u] == kUnknown) {
+      state[u] = kOnWalk;
+      walk.push_back(u);
+      u = parent[u];
+    }
+    if (state[u] == kOnWalk) {
+      cout << v << ": parents form a cycle" << endl;
+      return false;
+    }
+    for (NodeID w : walk)
+      state[w] = kReachesSource;
+    walk.resize(0);
+  }
+  return true;
+}
+
+// Simple serial Dijkstra implementation to get oracle distances, using a
+// radix heap since the keys it pops only increase
+template <typename WGraphT_>
+pvector<WeightT> SerialDijkstra(const WGraphT_ &g, NodeID source) {
+  pvector<WeightT> oracle_dist(g.num_nodes(), kDistInf);
+  oracle_dist[source] = 0;
+  RadixHeap<WeightT, NodeID> mq;
+  mq.push(0, source);
+  while (!mq.empty()) {
+    pair<WeightT, NodeID> top = mq.pop();
+    WeightT td = top.first;
+    NodeID u = top.second;
+    if (td == oracle_dist[u]) {
+      for (WNode wn : g.out_neigh(u)) {
+        if (td + wn.w < oracle_dist[wn.v]) {
+          oracle_dist[wn.v] = td + wn.w;
+          mq.push(td + wn.w, wn.v);
+        }
+      }
+    }
+  }
+  return oracle_dist;
+}
+
+// Compares against oracle distances (from SerialDijkstra, computed once per
+// source by the caller), and if given parents, also checks they form a
+// shortest-path tree
+template <typename WGraphT_>
+bool SSSPVerifier(const WGraphT_ &g, NodeID source,
+                  const pvector<WeightT> &oracle_dist,
+                  const pvector<WeightT> &dist_to_test,
+                  const pvector<NodeID> *parent = nullptr) {
+  int64_t num_mismatches = 0;
+  #pragma omp parallel for reduction(+ : num_mismatches)
+  for (NodeID n = 0; n < g.num_nodes(); n++)
+    num_mismatches += dist_to_test[n] != oracle_dist[n];
+  // Report any mismatches
+  if (num_mismatches != 0) {
+    for (NodeID n : g.vertices()) {
+      if (dist_to_test[n] != oracle_dist[n])
+        cout << n << ": " << dist_to_test[n] << " != " << oracle_dist[n]
+             << endl;
+    }
+  }
+  bool all_ok = num_mismatches == 0;
+  if (parent != nullptr)
+    all_ok = VerifyParents(g, source, dist_to_test, *parent) && all_ok;
+  return all_ok;
+}
+
+// Distances from each of k landmarks (V x k, so a vertex's are contiguous),
+// used for ALT lower bounds. Each landmark is the vertex farthest from those
+// already chosen (among ones they reach), starting from a random one.
+template <typename WGraphT_>
+pvector<WeightT> ComputeLandmarkDists(const WGraphT_ &g, int num_landmarks,
+                                      WeightT delta, DeltaStepContext &ctx) {
+  const int64_t K = num_landmarks;
+  pvector<WeightT> landmark_dists(g.num_nodes() * K);
+  pvector<WeightT> nearest(g.num_nodes(), kDistInf);
+  SourcePicker<WGraphT_> sp(g);
+  NodeID next = sp.PickNext();
+  for (int64_t k = 0; k < K; k++) {
+    pvector<WeightT> dist = DeltaStep(g, next, delta, ctx);
+    #pragma omp parallel for
+    for (NodeID n = 0; n < g.num_nodes(); n++) {
+      landmark_dists[n * K + k] = dist[n];
+      nearest[n] = min(nearest[n], dist[n]);
+    }
+    for (NodeID n : g.vertices()) {
+      if ((nearest[n] != kDistInf) && (nearest[n] > nearest[next]))
+        next = n;
+    }
+  }
+  return landmark_dists;
+}
+
+
+// Bidirectional Dijkstra for point-to-point queries, with optional ALT
+// (A*, landmarks, triangle inequality) potentials. Both searches use the
+// average of the forward and backward landmark bounds as a consistent
+// potential, so a query can stop once the smallest keys of the two queues sum
+// to at least the best path found. Arrays are sized for the whole graph once
+// and only the vertices a query touches are reset afterwards.
+template <typename WGraphT_>
+class PointToPoint {
+  typedef pair<double, NodeID> KeyNode;
+  typedef priority_queue<KeyNode, vector<KeyNode>, greater<KeyNode>> MinQueue;
+
+ public:
+  PointToPoint(const WGraphT_ &g, const pvector<WeightT> &landmark_dists,
+               int num_landmarks)
+      : g_(g), landmark_dists_(landmark_dists), num_landmarks_(num_landmarks),
+        dist_f_(g.num_nodes(), kDistInf), dist_b_(g.num_nodes(), kDistInf),
+        parent_f_(g.num_nodes(), -1), parent_b_(g.num_nodes(), -1),
+        potential_(g.num_nodes()), has_potential_(g.num_nodes(), false),
+        scanned_(0) {}
+
+  // Returns the shortest path from source to target (empty if unreachable)
+  vector<NodeID> Query(NodeID source, NodeID target) {
+    source_ = source;
+    target_ = target;
+    scanned_ = 0;
+    MinQueue queue_f, queue_b;
+    Label(source, 0, source, dist_f_, parent_f_);
+    Label(target, 0, target, dist_b_, parent_b_);
+    queue_f.push(make_pair(Potential(source), source));
+    queue_b.push(make_pair(-Potential(target), target));
+    WeightT best = source == target ? 0 : kDistInf;
+    NodeID meet = source == target ? source : -1;
+    while (!queue_f.empty() && !queue_b.empty()) {
+      if (queue_f.top().first + queue_b.top().first >= best)
+        break;
+      if (queue_f.size() <= queue_b.size())
+        Scan(queue_f, false, best, meet);
+      else
+        Scan(queue_b, true, best, meet);
+    }
+    vector<NodeID> path;
+    if (meet != -1) {
+      for (NodeID v = meet; v != source; v = parent_f_[v])
+        path.push_back(v);
+      path.push_back(source);
+      reverse(path.begin(), path.end());
+      for (NodeID v = meet; v != target; v = parent_b_[v])
+        path.push_back(parent_b_[v]);
+    }
+    Reset();
+    return path;
+  }
+
+  int64_t scanned() const { return scanned_; }
+
+ private:
+  void Label(NodeID v, WeightT d, NodeID parent, pvector<WeightT> &dist,
+             pvector<NodeID> &parents) {
+    if ((dist_f_[v] == kDistInf) && (dist_b_[v] == kDistInf))
+      touched_.push_back(v);
+    dist[v] = d;
+    parents[v] = parent;
+  }
+
+  // (lower bound to target - lower bound from source) / 2
+  double Potential(NodeID v) {
+    if (num_landmarks_ == 0)
+      return 0;
+    if (!has_potential_[v]) {
+      potential_[v] = (Bound(v, target_) - Bound(source_, v)) / 2;
+      has_potential_[v] = true;
+      touched_potentials_.push_back(v);
+    }
+    return potential_[v];
+  }
 
-  SourcePicker<WGraph> sp(g, cli.sources_filename(), cli.start_vertex());
+  // Lower bound on dist(u, v) from d(L,v) <= d(L,u) + d(u,v), and for
+  // undirected graphs also d(u,L) <= d(u,v) + d(v,L)
+  double Bound(NodeID u, NodeID v) const {
+    const WeightT *du = landmark_dists_.data() + u * int64_t(num_landmarks_);
+    const WeightT *dv = landmark_dists_.data() + v * int64_t(num_landmarks_);
+    double bound = 0;
+    for (int k = 0; k < num_landmarks_; k++) {
+      if ((du[k] == kDistInf) || (dv[k] == kDistInf))
+        continue;
+      double diff = static_cast<double>(dv[k]) - du[k];
+      bound = max(bound, g_.directed() ? diff : abs(diff));
+    }
+    return bound;
+  }
+
+  void Scan(MinQueue &queue, bool backward, WeightT &best, NodeID &meet) {
+    pvector<WeightT> &dist = backward ? dist_b_ : dist_f_;
+    pvector<WeightT> &other_dist = backward ? dist_f_ : dist_b_;
+    pvector<NodeID> &parents = backward ? parent_b_ : parent_f_;
+    const double sign = backward ? -1 : 1;
+    double key = queue.top().first;
+    NodeID u = queue.top().second;
+    queue.pop();
+    if (key != dist[u] + sign * Potential(u))
+      return;  // stale entry
+    scanned_++;
+    auto relax = [&](NodeID v, WeightT w) {
+      WeightT new_dist = dist[u] + w;
+      if (new_dist < dist[v]) {
+        Label(v, new_dist, u, dist, parents);
+        queue.push(make_pair(new_dist + sign * Potential(v), v));
+        if ((other_dist[v] != kDistInf) && (new_dist + other_dist[v] < best)) {
+          best = new_dist + other_dist[v];
+          meet = v;
+        }
+      }
+    };
+    if (backward) {
+      for (WNode wn : g_.in_neigh(u))
+        relax(wn.v, wn.w);
+    } else {
+      for (WNode wn : g_.out_neigh(u))
+        relax(wn.v, wn.w);
+    }
+  }
+
+  void Reset() {
+    for (NodeID v : touched_) {
+      dist_f_[v] = kDistInf;
+      dist_b_[v] = kDistInf;
+      parent_f_[v] = -1;
+      parent_b_[v] = -1;
+    }
+    touched_.resize(0);
+    for (NodeID v : touched_potentials_)
+      has_potential_[v] = false;
+    touched_potentials_.resize(0);
+  }
+
+  const WGraphT_ &g_;
+  const pvector<WeightT> &landmark_dists_;
+  const int num_landmarks_;
+  NodeID source_;
+  NodeID target_;
+  pvector<WeightT> dist_f_;
+  pvector<WeightT> dist_b_;
+  pvector<NodeID> parent_f_;
+  pvector<NodeID> parent_b_;
+  pvector<double> potential_;
+  vector<bool> has_potential_;
+  vector<NodeID> touched_;
+  vector<NodeID> touched_potentials_;
+  int64_t scanned_;
+};
+
+// Length of path, adding the lightest edge between consecutive vertices in
+// order from the source (so float sums match the verifier's), or kDistInf if
+// some edge is missing
+template <typename WGraphT_>
+WeightT PathLength(const WGraphT_ &g, const vector<NodeID> &path) {
+  if (path.empty())
+    return kDistInf;
+  WeightT length = 0;
+  for (size_t i = 1; i < path.size(); i++) {
+    WeightT lightest = kDistInf;
+    for (WNode wn : g.out_neigh(path[i - 1])) {
+      if (wn.v == path[i])
+        lightest = min(lightest, wn.w);
+    }
+    if (lightest == kDistInf)
+      return kDistInf;
+    length += lightest;
+  }
+  return length;
+}
+
+// Queries from a file (-Q), or from the usual sources to -t (a fixed vertex
+// or random ones)
+template <typename WGraphT_>
+vector<pair<NodeID, NodeID>> PickQueries(const CLSSSP<WeightT> &cli,
+                                         const WGraphT_ &g) {
+  vector<pair<NodeID, NodeID>> queries;
+  if (cli.queries_filename() != "") {
+    vector<NodeID> ids = VectorReader<NodeID>(cli.queries_filename()).Read();
+    for (size_t i = 0; i + 1 < ids.size(); i += 2)
+      queries.push_back(make_pair(ids[i], ids[i + 1]));
+    return queries;
+  }
+  SourcePicker<WGraphT_> sp(g, cli.sources_filename(), cli.start_vertex());
+  SourcePicker<WGraphT_> tp(g);
+  tp.PickNext();  // offset so random targets differ from random sources
+  for (int i = 0; i < cli.num_sources(); i++) {
+    NodeID source = sp.PickNext();
+    NodeID target = cli.random_targets() ? tp.PickNext() : cli.target();
+    queries.push_back(make_pair(source, target));
+  }
+  return queries;
+}
+
+// Runs each query (-n times) one at a time and reports the distribution of
+// query latencies
+template <typename WGraphT_>
+void RunPointToPoint(const CLSSSP<WeightT> &cli, const WGraphT_ &g,
+                     WeightT delta) {
+  Timer t;
+  pvector<WeightT> landmark_dists;
+  if (cli.num_landmarks() > 0) {
+    DeltaStepContext ctx(g.num_edges_directed() + 1);
+    t.Start();
+    landmark_dists = ComputeLandmarkDists(g, cli.num_landmarks(), delta, ctx);
+    t.Stop();
+    PrintTime("Landmark Time", t.Seconds());
+  }
+  vector<pair<NodeID, NodeID>> queries = PickQueries(cli, g);
+  PointToPoint<WGraphT_> p2p(g, landmark_dists, cli.num_landmarks());
+  OracleCache<NodeID, pvector<WeightT>> oracle;
+  vector<double> latencies;
+  int64_t total_scanned = 0;
+  bool all_ok = true;
+  for (int iter = 0; iter < cli.num_trials(); iter++) {
+    for (const pair<NodeID, NodeID> &query : queries) {
+      t.Start();
+      vector<NodeID> path = p2p.Query(query.first, query.second);
+      WeightT dist = PathLength(g, path);
+      t.Stop();
+      latencies.push_back(t.Seconds());
+      total_scanned += p2p.scanned();
+      if (cli.logging_en()) {
+        cout << "Query " << query.first << " -> " << query.second << ": ";
+        if (path.empty())
+          cout << "unreachable";
+        else
+          cout << dist << " (" << path.size() - 1 << " hops)";
+        cout << ", " << p2p.scanned() << " scanned" << endl;
+      }
+      if (cli.do_verify() && (iter == 0)) {
+        const pvector<WeightT> &oracle_dist = oracle.Get(query.first, [&] {
+          return SerialDijkstra(g, query.first);
+        });
+        if (dist != oracle_dist[query.second]) {
+          cout << query.first << " -> " << query.second << ": " << dist
+               << " != " << oracle_dist[query.second] << endl;
+          all_ok = false;
+        }
+      }
+    }
+  }
+  if (latencies.empty())
+    return;
+  sort(latencies.begin(), latencies.end());
+  double total_seconds = 0;
+  for (double seconds : latencies)
+    total_seconds += seconds;
+  auto Percentile = [&latencies](double p) {
+    return latencies[min(static_cast<size_t>(p * latencies.size()),
+                         latencies.size() - 1)];
+  };
+  PrintStep("Queries", static_cast<int64_t>(latencies.size()));
+  PrintStep("Avg Scanned", total_scanned / static_cast<int64_t>(
+                                              latencies.size()));
+  PrintTime("Query p50 Time", Percentile(0.5));
+  PrintTime("Query p90 Time", Percentile(0.9));
+  PrintTime("Query p99 Time", Percentile(0.99));
+  PrintTime("Query Max Time", latencies.back());
+  PrintTime("Average Time", total_seconds / latencies.size());
+  if (cli.do_verify())
+    PrintLabel("Verification", all_ok ? "PASS" : "FAIL");
+}
+
+// Maps weights from file (-w) and scatters them into the graph. For directed
+// graphs this needs the out-edge to in-edge permutation, which can be cached
+// next to the graph file (-P) so it is only computed once per graph. The cache
+// starts with the graph's node count, edge count, and topology checksum, and
+// is recomputed (and rewritten) if they don't match the loaded graph.
+template <typename WGraphT_>
+void ReplaceWeightsFromFile(const CLSSSP<WeightT> &cli, WGraphT_ &g) {
+  Timer t;
+  VectorReader<WeightT> reader(cli.weights_filename());
+  MappedVector<WeightT> weights = reader.MapSerialized();
+  if (weights.size() != static_cast<size_t>(g.num_edges_directed())) {
+    cout << "Weights file has " << weights.size() << " values but graph has "
+         << g.num_edges_directed() << " edges" << endl;
+    exit(-9);
+  }
+  bool cache_perm = cli.cache_permutation() && (cli.filename() != "");
+  string perm_filename = cli.filename() + ".perm";
+  const SGOffset *perm = nullptr;
+  MappedVector<SGOffset> cached_perm;
+  pvector<SGOffset> computed_perm;
+  if (g.directed()) {
+    vector<SGOffset> perm_key;
+    if (cache_perm) {
+      perm_key = {g.num_nodes(), g.num_edges_directed(),
+                  static_cast<SGOffset>(g.TopologyChecksum())};
+      cached_perm = VectorReader<SGOffset>(perm_filename).MapSerialized(false);
+      const size_t key_size = perm_key.size();
+      if ((cached_perm.size() == key_size + weights.size()) &&
+          std::equal(perm_key.begin(), perm_key.end(), cached_perm.data()))
+        perm = cached_perm.data() + key_size;
+      else if (ifstream(perm_filename).good())
+        cout << "Ignoring stale permutation cache " << perm_filename << endl;
+    }
+    if (perm == nullptr) {
+      t.Start();
+      computed_perm = g.InEdgePermutation();
+      t.Stop();
+      PrintTime("Permutation Time", t.Seconds());
+      perm = computed_perm.data();
+      if (cache_perm) {
+        cached_perm = MappedVector<SGOffset>();
+        VectorWriter<SGOffset> writer(perm_filename);
+        if (!writer.TryWriteSerialized(computed_perm.data(),
+                                       computed_perm.size(), perm_key)) {
+          cout << "Couldn't save permutation to " << perm_filename << endl;
+        }
+      }
+    }
+  }
+  t.Start();
+  g.ReplaceWeights(weights.data(), weights.size(), perm);
+  t.Stop();
+  PrintTime("Replace Weights Time", t.Seconds());
+}
+
+template <typename WGraphT_>
+void PrintBatchedSSSPStats(const WGraphT_ &g, const pvector<WeightT> &dist) {
+  WeightT max_dist = 0;
+  int64_t num_reached = 0;
+
+#pragma omp parallel for reduction(+ : num_reached) reduction(max : max_dist)
+  for (size_t i = 0; i < dist.size(); i++) {
+    if (dist[i] != kDistInf && dist[i] > max_dist)
+      max_dist = dist[i];
+    if (dist[i] != kDistInf)
+      num_reached++;
+  }
+
+  cout << "SSSP Trees reach " << num_reached / (dist.size() / g.num_nodes())
+       << " nodes on average" << endl;
+  cout << "Max dist " << max_dist << endl;
+}
+
+// Oracle distances for a batch (V x K like BatchedDeltaStep's), one serial
+// Dijkstra per source run in parallel
+template <typename WGraphT_>
+pvector<WeightT> BatchedSerialDijkstra(const WGraphT_ &g,
+                                       const vector<NodeID> &sources) {
+  const int64_t K = sources.size();
+  pvector<WeightT> oracle_dists(g.num_nodes() * K);
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int64_t k = 0; k < K; k++) {
+    pvector<WeightT> oracle_dist = SerialDijkstra(g, sources[k]);
+    for (NodeID n = 0; n < g.num_nodes(); n++)
+      oracle_dists[n * K + k] = oracle_dist[n];
+  }
+  return oracle_dists;
+}
+
+// Checks each source of a batch against its oracle distances
+template <typename WGraphT_>
+bool BatchedSSSPVerifier(const WGraphT_ &g, const vector<NodeID> &sources,
+                         const pvector<WeightT> &oracle_dists,
+                         const pvector<WeightT> &dist_to_test) {
+  const int64_t K = sources.size();
+  int64_t num_mismatches = 0;
+  #pragma omp parallel for reduction(+ : num_mismatches)
+  for (int64_t i = 0; i < g.num_nodes() * K; i++)
+    num_mismatches += dist_to_test[i] != oracle_dists[i];
+  if (num_mismatches != 0) {
+    for (int64_t i = 0; i < g.num_nodes() * K; i++) {
+      if (dist_to_test[i] != oracle_dists[i])
+        cout << i / K << " (from " << sources[i % K] << "): "
+             << dist_to_test[i] << " != " << oracle_dists[i] << endl;
+    }
+  }
+  return num_mismatches == 0;
+}
+
+// Runs the sources in batches of -B and reports the overall throughput
+template <typename WGraphT_>
+void RunBatchedSSSP(const CLSSSP<WeightT> &cli, const WGraphT_ &g,
+                    WeightT delta) {
+  const int64_t batch_size = cli.batch_size();
+  DeltaStepContext ctx((g.num_edges_directed() + 1) * batch_size);
+  SourcePicker<WGraphT_> sp(g, cli.sources_filename(), cli.start_vertex());
+  double kernel_seconds = 0;
+  int64_t sources_run = 0;
+  for (int64_t first = 0; first < cli.num_sources(); first += batch_size) {
+    vector<NodeID> sources;
+    while ((static_cast<int64_t>(sources.size()) < batch_size) &&
+           (first + static_cast<int64_t>(sources.size()) < cli.num_sources()))
+      sources.push_back(sp.PickNext());
+    cout << "Sources:";
+    for (NodeID source : sources)
+      cout << " " << source;
+    cout << endl;
+
+    auto SSSPBound = [&](const WGraphT_ &g) {
+      Timer t;
+      t.Start();
+      pvector<WeightT> dist = BatchedDeltaStep(g, sources, delta, ctx,
+                                               cli.logging_en());
+      t.Stop();
+      kernel_seconds += t.Seconds();
+      sources_run += sources.size();
+      return dist;
+    };
+
+    OracleCache<vector<NodeID>, pvector<WeightT>> oracle;
+    auto VerifierBound = [&sources, &oracle](const WGraphT_ &g,
+                                             const pvector<WeightT> &dist) {
+      const pvector<WeightT> &oracle_dists = oracle.Get(sources, [&] {
+        return BatchedSerialDijkstra(g, sources);
+      });
+      return BatchedSSSPVerifier(g, sources, oracle_dists, dist);
+    };
+
+    BenchmarkKernel(cli, g, SSSPBound, PrintBatchedSSSPStats<WGraphT_>,
+                    VerifierBound);
+  }
+  if ((kernel_seconds > 0) && (sources_run > 0))
+    PrintLabel("Sources per Second",
+               to_string(static_cast<int64_t>(sources_run / kernel_seconds)));
+}
+
+// Shortest paths using at most max_hops edges (-p hops:h), by rounds of
+// Bellman-Ford from the vertices improved in the previous round. A round reads
+// the distances from before it (dist) and writes to next_dist, so each round
+// extends paths by exactly one edge. The two are equal between rounds, since
+// only the vertices a round improved are copied back.
+template <typename WGraphT_>
+pvector<WeightT> HopLimitedSSSP(const WGraphT_ &g, NodeID source,
+                                int max_hops, bool logging_enabled = false) {
+  Timer t;
+  pvector<WeightT> dist(g.num_nodes(), kDistInf);
+  pvector<WeightT> next_dist(g.num_nodes(), kDistInf);
+  pvector<int> queued_round(g.num_nodes(), -1);
+  pvector<NodeID> frontier(g.num_nodes());
+  pvector<NodeID> next_frontier(g.num_nodes());
+  dist[source] = 0;
+  next_dist[source] = 0;
+  frontier[0] = source;
+  size_t frontier_size = 1;
+  for (int round = 0; (round < max_hops) && (frontier_size > 0); round++) {
+    t.Start();
+    size_t next_size = 0;
+    #pragma omp parallel
+    {
+      vector<NodeID> local_frontier;
+      #pragma omp for nowait schedule(dynamic, 64)
+      for (size_t i = 0; i < frontier_size; i++) {
+        NodeID u = frontier[i];
+        for (WNode wn : g.out_neigh(u)) {
+          if (UpdateDist(next_dist, wn.v, dist[u] + wn.w, u)) {
+            int queued = queued_round[wn.v];
+            if ((queued != round) &&
+                compare_and_swap(queued_round[wn.v], queued, round))
+              local_frontier.push_back(wn.v);
+          }
+        }
+      }
+      size_t copy_start = fetch_and_add(next_size, local_frontier.size());
+      copy(local_frontier.begin(), local_frontier.end(),
+           next_frontier.begin() + copy_start);
+    }
+    #pragma omp parallel for
+    for (size_t i = 0; i < next_size; i++)
+      dist[next_frontier[i]] = next_dist[next_frontier[i]];
+    frontier.swap(next_frontier);
+    frontier_size = next_size;
+    t.Stop();
+    if (logging_enabled)
+      PrintStep(round + 1, t.Millisecs(), frontier_size);
+  }
+  return dist;
+}
+
+// Reached vertices and the worst value among them (e.g. the narrowest
+// bottleneck), for policies other than shortest paths
+template <typename WGraphT_, typename PolicyT_>
+void PrintPathStats(const WGraphT_ &g, const pvector<WeightT> &dist,
+                    const PolicyT_ &policy) {
+  int64_t num_reached = 0;
+  WeightT worst = policy.Origin();
+  #pragma omp parallel
+  {
+    WeightT local_worst = policy.Origin();
+    #pragma omp for reduction(+ : num_reached) nowait
+    for (NodeID n = 0; n < g.num_nodes(); n++) {
+      if (dist[n] != policy.Unreached()) {
+        num_reached++;
+        if (policy.Better(local_worst, dist[n]))
+          local_worst = dist[n];
+      }
+    }
+    #pragma omp critical
+    if (policy.Better(worst, local_worst))
+      worst = local_worst;
+  }
+  cout << "Paths reach " << num_reached << " nodes" << endl;
+  cout << "Worst value " << worst << endl;
+}
+
+// Serial Dijkstra for any policy (with a binary heap ordered by Better) to get
+// oracle values
+template <typename WGraphT_, typename PolicyT_>
+pvector<WeightT> SerialBestPaths(const WGraphT_ &g, NodeID source,
+                                 const PolicyT_ &policy) {
+  typedef pair<WeightT, NodeID> WN;
+  auto Worse = [&policy](const WN &a, const WN &b) {
+    return policy.Better(b.first, a.first);
+  };
+  pvector<WeightT> oracle_dist(g.num_nodes(), policy.Unreached());
+  oracle_dist[source] = policy.Origin();
+  priority_queue<WN, vector<WN>, decltype(Worse)> mq(Worse);
+  mq.push(make_pair(policy.Origin(), source));
+  while (!mq.empty()) {
+    WeightT td = mq.top().first;
+    NodeID u = mq.top().second;
+    mq.pop();
+    if (td == oracle_dist[u]) {
+      for (WNode wn : g.out_neigh(u)) {
+        WeightT new_dist = policy.Extend(td, wn.w);
+        if (policy.Better(new_dist, oracle_dist[wn.v])) {
+          oracle_dist[wn.v] = new_dist;
+          mq.push(make_pair(new_dist, wn.v));
+        }
+      }
+    }
+  }
+  return oracle_dist;
+}
+
+// Serial Bellman-Ford limited to max_hops rounds over all edges, to get
+// oracle distances for -p hops:h
+template <typename WGraphT_>
+pvector<WeightT> SerialHopLimited(const WGraphT_ &g, NodeID source,
+                                  int max_hops) {
+  pvector<WeightT> oracle_dist(g.num_nodes(), kDistInf);
+  oracle_dist[source] = 0;
+  for (int round = 0; round < max_hops; round++) {
+    pvector<WeightT> next_dist(oracle_dist.begin(), oracle_dist.end());
+    bool changed = false;
+    for (NodeID u : g.vertices()) {
+      if (oracle_dist[u] == kDistInf)
+        continue;
+      for (WNode wn : g.out_neigh(u)) {
+        if (oracle_dist[u] + wn.w < next_dist[wn.v]) {
+          next_dist[wn.v] = oracle_dist[u] + wn.w;
+          changed = true;
+        }
+      }
+    }
+    oracle_dist.swap(next_dist);
+    if (!changed)
+      break;
+  }
+  return oracle_dist;
+}
+
+// Runs the usual sources under a policy other than shortest paths (-p), with
+// the same kernel choices (-K) as shortest paths
+template <typename WGraphT_, typename PolicyT_>
+void RunPathPolicy(const CLSSSP<WeightT> &cli, const WGraphT_ &g,
+                   WeightT delta, const PolicyT_ &policy) {
+  bool radix = (cli.kernel() == "radix") ||
+               ((cli.kernel() == "auto") && (omp_get_max_threads() == 1));
+  DeltaStepContext ctx(g.num_edges_directed() + 1);
+  OracleCache<NodeID, pvector<WeightT>> oracle;
+  SourcePicker<WGraphT_> sp(g, cli.sources_filename(), cli.start_vertex());
+  for (auto i = 0; i < cli.num_sources(); i++) {
+    auto source = sp.PickNext();
+    std::cout << "Source: " << source << std::endl;
+
+    auto PathBound = [&, source](const WGraphT_ &g) {
+      if (radix)
+        return RadixDijkstra<WGraphT_, pvector<WeightT>>(g, source, policy);
+      if (cli.kernel() == "buckets")
+        return BucketStep<WGraphT_, pvector<WeightT>>(
+            g, source, delta, ctx, cli.logging_en(), policy);
+      return DeltaStep<WGraphT_, pvector<WeightT>>(
+          g, source, delta, ctx, cli.logging_en(), false,
+          cli.kernel() == "auto", policy);
+    };
+
+    auto StatsBound = [&policy](const WGraphT_ &g,
+                                const pvector<WeightT> &dist) {
+      PrintPathStats(g, dist, policy);
+    };
+
+    auto VerifierBound = [&oracle, &policy, source](
+        const WGraphT_ &g, const pvector<WeightT> &dist) {
+      const pvector<WeightT> &oracle_dist = oracle.Get(source, [&] {
+        return SerialBestPaths(g, source, policy);
+      });
+      return SSSPVerifier(g, source, oracle_dist, dist);
+    };
+
+    BenchmarkKernel(cli, g, PathBound, StatsBound, VerifierBound);
+  }
+}
+
+// Runs the usual sources with -p hops:h
+template <typename WGraphT_>
+void RunHopLimited(const CLSSSP<WeightT> &cli, const WGraphT_ &g,
+                   int max_hops) {
+  OracleCache<NodeID, pvector<WeightT>> oracle;
+  SourcePicker<WGraphT_> sp(g, cli.sources_filename(), cli.start_vertex());
+  for (auto i = 0; i < cli.num_sources(); i++) {
+    auto source = sp.PickNext();
+    std::cout << "Source: " << source << std::endl;
+
+    auto HopsBound = [&cli, source, max_hops](const WGraphT_ &g) {
+      return HopLimitedSSSP(g, source, max_hops, cli.logging_en());
+    };
+
+    auto VerifierBound = [&oracle, source, max_hops](
+        const WGraphT_ &g, const pvector<WeightT> &dist) {
+      const pvector<WeightT> &oracle_dist = oracle.Get(source, [&] {
+        return SerialHopLimited(g, source, max_hops);
+      });
+      return SSSPVerifier(g, source, oracle_dist, dist);
+    };
+
+    BenchmarkKernel(cli, g, HopsBound, PrintSSSPStats<WGraphT_>,
+                    VerifierBound);
+  }
+}
+
+// Delta from -d, or for -d auto picked for the policy's keys
+template <typename WGraphT_, typename PolicyT_>
+WeightT PickDelta(const CLSSSP<WeightT> &cli, const WGraphT_ &g,
+                  const PolicyT_ &policy) {
+  if (!cli.auto_delta())
+    return cli.delta();
+  WeightT delta = AutoDelta(g, policy);
+  cout << "Delta: " << delta << (cli.adapt_delta() ? " (adaptive)" : "")
+       << endl;
+  return delta;
+}
+
+// Dispatches -p to the policy's runner, returns false for shortest paths
+template <typename WGraphT_>
+bool RunOtherPolicy(const CLSSSP<WeightT> &cli, const WGraphT_ &g) {
+  string name = SpecName(cli.path_policy());
+  vector<double> params = SpecParams(cli.path_policy());
+  if (name == "shortest")
+    return false;
+  if (cli.light_heavy() || cli.shortest_path_tree() ||
+      (cli.batch_size() > 1) || cli.point_to_point() || cli.adapt_delta())
+    cout << "-H, -T, -B, -t/-Q, and -d adapt only apply to shortest paths"
+         << endl;
+  if (name == "widest") {
+    WeightT max_weight = 0;
+    #pragma omp parallel for reduction(max : max_weight)
+    for (NodeID u = 0; u < g.num_nodes(); u++) {
+      for (WNode wn : g.out_neigh(u))
+        max_weight = max(max_weight, wn.w);
+    }
+    WidestPaths policy(max_weight);
+    RunPathPolicy(cli, g, PickDelta(cli, g, policy), policy);
+  } else if (name == "reliable") {
+    bool probabilities = is_floating_point<WeightT>::value;
+    #pragma omp parallel for reduction(&& : probabilities)
+    for (NodeID u = 0; u < g.num_nodes(); u++) {
+      for (WNode wn : g.out_neigh(u))
+        probabilities = probabilities && (wn.w > 0) && (wn.w <= 1);
+    }
+    if (!probabilities) {
+      cout << "Reliable paths need float weights in (0, 1] "
+           << "(e.g. sssp-float with -W uniform:0.5,1)" << endl;
+      exit(-10);
+    }
+    ReliablePaths policy;
+    RunPathPolicy(cli, g, PickDelta(cli, g, policy), policy);
+  } else if ((name == "hops") && !params.empty() && (params[0] >= 1)) {
+    RunHopLimited(cli, g, static_cast<int>(params[0]));
+  } else {
+    cout << "Unknown path policy: " << cli.path_policy() << endl;
+    exit(-10);
+  }
+  return true;
+}
+
+template <typename WGraphT_>
+void RunSSSP(const CLSSSP<WeightT> &cli, WGraphT_ &g) {
+  if ((cli.kernel() != "auto") && (cli.kernel() != "delta") &&
+      (cli.kernel() != "radix") && (cli.kernel() != "buckets")) {
+    cout << "Unknown SSSP kernel: " << cli.kernel() << endl;
+    exit(-10);
+  }
+  if (cli.weights_filename() != "")
+    ReplaceWeightsFromFile(cli, g);
+
+  if (cli.light_heavy() && (cli.batch_size() == 1)) {
+    Timer t;
+    t.Start();
+    SortNeighborhoodsByWeight(g);
+    t.Stop();
+    PrintTime("Sort Time", t.Seconds());
+    if (cli.adapt_delta())
+      cout << "Adaptive delta not supported with -H, keeping it fixed" << endl;
+  }
+
+  if (RunOtherPolicy(cli, g))
+    return;
+
+  WeightT delta = PickDelta(cli, g, ShortestPaths());
+
+  if (cli.point_to_point()) {
+    RunPointToPoint(cli, g, delta);
+    return;
+  }
+
+  if (cli.batch_size() > 1) {
+    if (cli.light_heavy() || cli.adapt_delta() || cli.shortest_path_tree())
+      cout << "Batches use plain delta-stepping with a fixed delta and "
+           << "don't compute parents" << endl;
+    RunBatchedSSSP(cli, g, delta);
+    return;
+  }
+
+  bool radix = (cli.kernel() == "radix") ||
+               ((cli.kernel() == "auto") && (omp_get_max_threads() == 1) &&
+                !cli.light_heavy() && !cli.adapt_delta());
+  bool serial_tail = (cli.kernel() == "auto") && !cli.adapt_delta();
+  bool buckets = cli.kernel() == "buckets";
+  if (radix)
+    cout << "Kernel: radix heap Dijkstra" << endl;
+
+  DeltaStepContext ctx(g.num_edges_directed() + 1);
+  OracleCache<NodeID, pvector<WeightT>> oracle;
+  auto OracleDist = [&oracle](const WGraphT_ &g, NodeID source)
+      -> const pvector<WeightT>& {
+    return oracle.Get(source, [&] { return SerialDijkstra(g, source); });
+  };
+  SourcePicker<WGraphT_> sp(g, cli.sources_filename(), cli.start_vertex());
   for (auto i = 0; i < cli.num_sources(); i++) {
     auto source = sp.PickNext();
     std::cout << "Source: " << source << std::endl;
 
-    auto SSSPBound = [&sp, &cli, source](const WGraph &g) {
-      return DeltaStep(g, source, cli.delta(), cli.logging_en());
+    if (cli.shortest_path_tree()) {
+      auto SSSPTreeBound = [&, source](const WGraphT_ &g) {
+        if (radix)
+          return RadixDijkstra<WGraphT_, DistParentArray>(g, source);
+        if (buckets)
+          return BucketStep<WGraphT_, DistParentArray>(g, source, delta, ctx,
+                                                       cli.logging_en());
+        if (cli.light_heavy())
+          return DeltaStepLH<WGraphT_, DistParentArray>(g, source, delta, ctx,
+                                                        cli.logging_en());
+        return DeltaStep<WGraphT_, DistParentArray>(
+            g, source, delta, ctx, cli.logging_en(), cli.adapt_delta(),
+            serial_tail);
+      };
+
+      auto TreeVerifierBound = [source, &OracleDist](
+          const WGraphT_ &g, const DistParentArray &tree) {
+        pvector<NodeID> parent = tree.parents();
+        return SSSPVerifier(g, source, OracleDist(g, source), tree.dists(),
+                            &parent);
+      };
+
+      BenchmarkKernel(cli, g, SSSPTreeBound, PrintSSSPTreeStats<WGraphT_>,
+                      TreeVerifierBound);
+      continue;
+    }
+
+    auto SSSPBound = [&, source](const WGraphT_ &g) {
+      if (radix)
+        return RadixDijkstra(g, source);
+      if (buckets)
+        return BucketStep(g, source, delta, ctx, cli.logging_en());
+      if (cli.light_heavy())
+        return DeltaStepLH(g, source, delta, ctx, cli.logging_en());
+      return DeltaStep(g, source, delta, ctx, cli.logging_en(),
+                       cli.adapt_delta(), serial_tail);
     };
 
-    auto VerifierBound = [source](const WGraph &g,
-                                  const pvector<WeightT> &dist) {
-      return SSSPVerifier(g, source, dist);
+    auto VerifierBound = [source, &OracleDist](const WGraphT_ &g,
+                                               const pvector<WeightT> &dist) {
+      return SSSPVerifier(g, source, OracleDist(g, source), dist);
     };
 
-    BenchmarkKernel(cli, g, SSSPBound, PrintSSSPStats, VerifierBound);
+    BenchmarkKernel(cli, g, SSSPBound, PrintSSSPStats<WGraphT_>,
+                    VerifierBound);
   }
+}
 
+int main(int argc, char *argv[]) {
+  CLSSSP<WeightT> cli(argc, argv, "single-source shortest-path");
+  if (!cli.ParseArgs())
+    return -1;
+  WeightedBuilder b(cli);
+  WGraph g = b.MakeGraph();
+  g.PrintStats();
+  if (cli.soa_layout()) {
+    SoAWGraph soa_g(std::move(g));
+    RunSSSP(cli, soa_g);
+  } else {
+    RunSSSP(cli, g);
+  }
   return 0;
 }
@@ -45,6 +45,13 @@ void PrintStep(int step, double seconds, int64_t count = -1) {
   PrintStep(std::to_string(step), seconds, count);
 }
 
+// Bijective 64-bit mixing function (finalizer from SplitMix64)
+inline uint64_t Mix64(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
 // Runs op and prints the time it took to execute labelled by label
 #define TIME_PRINT(label, op) {   \
   Timer t_;                       \
@@ -0,0 +1,209 @@
+// Copyright (c) 2015, The Regents of the University of California (Regents)
+// See LICENSE.txt for license details
+
+#ifndef WORK_QUEUE_H_
+#define WORK_QUEUE_H_
+
+#include <algorithm>
+#include <cinttypes>
+#include <thread>
+#include <vector>
+
+#include "platform_atomics.h"
+
+
+/*
+GAP Benchmark Suite
+Class:  WorkQueue
+
+Work-stealing scheduler for processing a frontier (items [0, n), e.g. indices
+into a queue of vertices) in parallel, one round per frontier
+ - Each thread starts with its own contiguous block of items, cut into chunks
+   in a deque, and takes chunks from the back (in item order)
+ - A thread that runs out steals half of the chunks left in another thread's
+   deque, from the front (the far end of the victim's block)
+ - Items with many edges are split into pieces of kSplitEdges edges pushed to
+   the finding thread's deque, so other threads can steal pieces of a hub
+   instead of waiting on the one thread that found it
+ - Deques are guarded by per-thread spinlocks that are held only to move a
+   few tasks, and a round ends once every thread is idle with an empty deque
+ - Every thread of the team must call Run() for every round, and rounds must
+   be separated by a barrier (so the counter for the next round can be reset
+   while the current one is in use, see Run)
+*/
+
+
+class WorkQueue {
+  static const int64_t kChunkSize = 64;
+  static const int64_t kSplitEdges = 1024;
+
+ public:
+  explicit WorkQueue(int max_threads) : threads_(max_threads) {
+    Reset(max_threads);
+  }
+
+  // Called by one thread of a team of num_threads threads (e.g. in an omp
+  // single) before the team's first round, so the first round's counter
+  // matches the team actually running, which can be smaller than the maximum
+  void Reset(int num_threads) {
+    for (ThreadState &ts : threads_)
+      ts.round = 0;
+    active_[0] = num_threads;
+  }
+
+  // Calls visit(i, edge_begin, edge_end) so that the calls (across threads)
+  // cover edges [0, degree(i)) of every item i in [0, num_items), with all
+  // but high-degree items visited by a single call
+  template <typename DegreeFunc, typename VisitFunc>
+  void Run(int thread, int num_threads, int64_t num_items, DegreeFunc degree,
+           VisitFunc visit) {
+    ThreadState &ts = threads_[thread];
+    int64_t &active = active_[ts.round & 1];
+    // No thread can finish this round before every thread has started it, so
+    // all threads are done resetting next round's counter by the time any
+    // thread starts the next round
+    active_[(ts.round + 1) & 1] = num_threads;
+    ts.round++;
+    PushBlock(ts, num_items * thread / num_threads,
+              num_items * (thread + 1) / num_threads);
+    Task task;
+    while (true) {
+      if (Pop(ts, task) || Steal(thread, num_threads, task)) {
+        Process(ts, task, degree, visit);
+        continue;
+      }
+      // idle until some deque has tasks or everyone is idle
+      fetch_and_add(active, -1);
+      while (!AnyTasks(num_threads)) {
+        if (Load(active) == 0)
+          return;
+        std::this_thread::yield();  // in case threads outnumber cores
+      }
+      fetch_and_add(active, 1);
+    }
+  }
+
+ private:
+  // Items [begin, end) if item is -1, or else edges [begin, end) of item
+  struct Task {
+    int64_t item;
+    int64_t begin;
+    int64_t end;
+  };
+
+  struct ThreadState {
+    ThreadState() : lock(0), head(0), num_tasks(0), round(0) {}
+    int lock;
+    std::vector<Task> tasks;  // deque is tasks[head, size)
+    size_t head;
+    int64_t num_tasks;        // size - head, for others to read without lock
+    int64_t round;
+    std::vector<Task> stolen;
+    char padding[64];         // avoid false sharing with neighbors
+  };
+
+  template <typename U_>
+  static U_ Load(U_ &x) {
+    return *const_cast<volatile U_*>(&x);
+  }
+
+  static void Lock(ThreadState &ts) {
+    while ((Load(ts.lock) != 0) || !compare_and_swap(ts.lock, 0, 1))
+      std::this_thread::yield();
+  }
+
+  static void Unlock(ThreadState &ts) {
+    __sync_lock_release(&ts.lock);
+  }
+
+  // Chunks pushed last to first, so the owner pops them in item order
+  void PushBlock(ThreadState &ts, int64_t begin, int64_t end) {
+    Lock(ts);
+    ts.tasks.resize(0);
+    ts.head = 0;
+    for (int64_t chunk_end = end; chunk_end > begin; chunk_end -= kChunkSize)
+      ts.tasks.push_back({-1, std::max(chunk_end - kChunkSize, begin),
+                          chunk_end});
+    ts.num_tasks = ts.tasks.size();
+    Unlock(ts);
+  }
+
+  bool Pop(ThreadState &ts, Task &task) {
+    Lock(ts);
+    bool found = ts.num_tasks > 0;
+    if (found) {
+      task = ts.tasks.back();
+      ts.tasks.pop_back();
+      ts.num_tasks--;
+    }
+    Unlock(ts);
+    return found;
+  }
+
+  // Takes half of a victim's tasks (rounded up) from the front, keeping one
+  // to process now and pushing the rest to this thread's deque
+  bool Steal(int thread, int num_threads, Task &task) {
+    for (int offset = 1; offset < num_threads; offset++) {
+      ThreadState &victim = threads_[(thread + offset) % num_threads];
+      if (Load(victim.num_tasks) == 0)
+        continue;
+      ThreadState &ts = threads_[thread];
+      Lock(victim);
+      int64_t num_stolen = (victim.num_tasks + 1) / 2;
+      ts.stolen.assign(victim.tasks.begin() + victim.head,
+                       victim.tasks.begin() + victim.head + num_stolen);
+      victim.head += num_stolen;
+      victim.num_tasks -= num_stolen;
+      if (victim.num_tasks == 0) {
+        victim.tasks.resize(0);
+        victim.head = 0;
+      }
+      Unlock(victim);
+      if (num_stolen == 0)
+        continue;
+      task = ts.stolen.front();
+      Lock(ts);
+      ts.tasks.insert(ts.tasks.end(), ts.stolen.rbegin(),
+                      ts.stolen.rend() - 1);
+      ts.num_tasks += num_stolen - 1;
+      Unlock(ts);
+      return true;
+    }
+    return false;
+  }
+
+  bool AnyTasks(int num_threads) {
+    for (int t = 0; t < num_threads; t++) {
+      if (Load(threads_[t].num_tasks) > 0)
+        return true;
+    }
+    return false;
+  }
+
+  template <typename DegreeFunc, typename VisitFunc>
+  void Process(ThreadState &ts, const Task &task, DegreeFunc degree,
+               VisitFunc visit) {
+    if (task.item != -1) {
+      visit(task.item, task.begin, task.end);
+      return;
+    }
+    for (int64_t i = task.begin; i < task.end; i++) {
+      int64_t num_edges = degree(i);
+      if (num_edges >= 2 * kSplitEdges) {
+        Lock(ts);
+        for (int64_t e = kSplitEdges; e < num_edges; e += kSplitEdges) {
+          ts.tasks.push_back({i, e, std::min(e + kSplitEdges, num_edges)});
+          ts.num_tasks++;
+        }
+        Unlock(ts);
+        num_edges = kSplitEdges;
+      }
+      visit(i, 0, num_edges);
+    }
+  }
+
+  std::vector<ThreadState> threads_;
+  int64_t active_[2];
+};
+
+#endif  // WORK_QUEUE_H_
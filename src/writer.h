@@ -5,12 +5,17 @@
 #define WRITER_H_
 
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <type_traits>
+#include <vector>
 
 #include "graph.h"
+#include "pvector.h"
+#include "sg_header.h"
 
 
 /*
@@ -21,6 +26,7 @@ Author: Scott Beamer
 Given filename and graph, writes out the graph to storage
  - Should use WriteGraph(filename, serialized)
  - If serialized, will write out as serialized graph, otherwise, as edgelist
+ - Serialized graphs use the version 2 format described in sg_header.h
 */
 
 
@@ -36,39 +42,57 @@ class WriterBase {
     }
   }
 
-  void WriteSerializedGraph(std::fstream &out) {
+  // Writes version 2 format (see sg_header.h), sections padded to alignment
+  void WriteSerializedGraph(std::fstream &out, bool checksums = false) {
     if (!std::is_same<NodeID_, SGID>::value) {
       std::cout << "serialized graphs only allowed for 32b IDs" << std::endl;
       std::exit(-4);
     }
-    if (!std::is_same<DestID_, NodeID_>::value &&
-        !std::is_same<DestID_, NodeWeight<NodeID_, SGID>>::value) {
-      std::cout << ".wsg only allowed for int32_t weights" << std::endl;
-      std::exit(-8);
-    }
     bool directed = g_.directed();
-    SGOffset num_nodes = g_.num_nodes();
-    SGOffset edges_to_write = g_.num_edges_directed();
-    std::streamsize index_bytes = (num_nodes+1) * sizeof(SGOffset);
-    std::streamsize neigh_bytes;
-    if (std::is_same<DestID_, NodeID_>::value)
-      neigh_bytes = edges_to_write * sizeof(SGID);
-    else
-      neigh_bytes = edges_to_write * sizeof(NodeWeight<NodeID_, SGID>);
-    out.write(reinterpret_cast<char*>(&directed), sizeof(bool));
-    out.write(reinterpret_cast<char*>(&edges_to_write), sizeof(SGOffset));
-    out.write(reinterpret_cast<char*>(&num_nodes), sizeof(SGOffset));
+    SGHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kSGMagic, sizeof(kSGMagic));
+    header.version = kSGVersion;
+    header.flags = (directed ? kSGDirected : 0) |
+                   (checksums ? kSGChecksums : 0);
+    header.id_bytes = sizeof(SGID);
+    header.offset_bytes = sizeof(SGOffset);
+    header.weight_type = SGDestWeightType<NodeID_, DestID_>::value;
+    header.weight_bytes = SGDestWeightType<NodeID_, DestID_>::bytes;
+    header.neigh_bytes = sizeof(DestID_);
+    header.num_nodes = g_.num_nodes();
+    header.num_edges = g_.num_edges_directed();
+    uint64_t index_bytes = (header.num_nodes+1) * sizeof(SGOffset);
+    uint64_t neigh_bytes = header.num_edges * sizeof(DestID_);
     pvector<SGOffset> offsets = g_.VertexOffsets(false);
-    out.write(reinterpret_cast<char*>(offsets.data()), index_bytes);
-    out.write(reinterpret_cast<char*>(g_.out_neigh(0).begin()), neigh_bytes);
-    if (directed) {
-      offsets = g_.VertexOffsets(true);
-      out.write(reinterpret_cast<char*>(offsets.data()), index_bytes);
-      out.write(reinterpret_cast<char*>(g_.in_neigh(0).begin()), neigh_bytes);
+    pvector<SGOffset> in_offsets;
+    if (directed)
+      in_offsets = g_.VertexOffsets(true);
+    const char* section_data[kSGNumSections] = {
+      reinterpret_cast<const char*>(offsets.data()),
+      reinterpret_cast<const char*>(g_.out_neigh(0).begin()),
+      directed ? reinterpret_cast<const char*>(in_offsets.data()) : nullptr,
+      directed ? reinterpret_cast<const char*>(g_.in_neigh(0).begin()) : nullptr
+    };
+    uint64_t pos = kSGAlignment;
+    for (int s=0; s < kSGNumSections; s++) {
+      SGSection &section = header.sections[s];
+      section.offset = pos;
+      if (section_data[s] == nullptr)
+        continue;
+      bool is_index = (s == kSGOutIndex) || (s == kSGInIndex);
+      section.bytes = is_index ? index_bytes : neigh_bytes;
+      if (checksums)
+        section.checksum = SGChecksum(section_data[s], section.bytes);
+      pos = SGAlignUp(pos + section.bytes);
     }
+    WritePadded(out, reinterpret_cast<const char*>(&header), sizeof(header));
+    for (int s=0; s < kSGNumSections; s++)
+      WritePadded(out, section_data[s], header.sections[s].bytes);
   }
 
-  void WriteGraph(std::string filename, bool serialized = false) {
+  void WriteGraph(std::string filename, bool serialized = false,
+                  bool checksums = false) {
     if (filename == "") {
       std::cout << "No output filename given (Use -h for help)" << std::endl;
       std::exit(-8);
@@ -79,15 +103,64 @@ class WriterBase {
       std::exit(-5);
     }
     if (serialized)
-      WriteSerializedGraph(file);
+      WriteSerializedGraph(file, checksums);
     else
       WriteEL(file);
     file.close();
   }
 
  private:
+  // Writes bytes and then zeros up to the next kSGAlignment boundary
+  static void WritePadded(std::fstream &out, const char *data, uint64_t bytes) {
+    static const char zeros[kSGAlignment] = {};
+    if (bytes != 0)
+      out.write(data, bytes);
+    uint64_t padding = SGAlignUp(bytes) - bytes;
+    out.write(zeros, padding);
+  }
+
   CSRGraph<NodeID_, DestID_> &g_;
   std::string filename_;
 };
 
+
+// Writes values in the format read by VectorReader::ReadSerialized
+template <typename ValueT_>
+class VectorWriter {
+ public:
+  explicit VectorWriter(std::string filename) : filename_(filename) {}
+
+  void WriteSerialized(const ValueT_ *values, int64_t num_values) {
+    if (!TryWriteSerialized(values, num_values)) {
+      std::cout << "Couldn't write to file " << filename_ << std::endl;
+      std::exit(-5);
+    }
+  }
+
+  // Like WriteSerialized, but returns false instead of exiting if the file
+  // can't be written (removing any partial file), for optional outputs such
+  // as caches. Values in prefix are written (and counted) before values.
+  bool TryWriteSerialized(const ValueT_ *values, int64_t num_values,
+                          const std::vector<ValueT_> &prefix = {}) {
+    std::fstream file(filename_, std::ios::out | std::ios::binary);
+    if (!file)
+      return false;
+    int64_t total = prefix.size() + num_values;
+    file.write(reinterpret_cast<char*>(&total), sizeof(total));
+    file.write(reinterpret_cast<const char*>(prefix.data()),
+               prefix.size() * sizeof(ValueT_));
+    file.write(reinterpret_cast<const char*>(values),
+               num_values * sizeof(ValueT_));
+    file.close();
+    if (file.fail()) {
+      std::remove(filename_.c_str());  // don't leave a truncated file behind
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  std::string filename_;
+};
+
 #endif  // WRITER_H_
@@ -7,7 +7,8 @@
 #-----------------------------------------------------------------------#
 
 # Dependencies are the tests it will run
-test-all: test-build test-generate test-load test-verify
+test-all: test-build test-generate test-load test-serialize test-wserialize \
+	test-weights test-verify
 
 # Does everthing, intended target for users
 test: test-score
@@ -39,7 +40,22 @@ test-build: all
 GENERATE_KERNEL = bfs
 
 # Built-in synthetic graph generators
-test-generate: test-generate-g10 test-generate-u10
+GENERATORS = rmat grid2d grid3d ba sbm
+
+test-generate: test-generate-g10 test-generate-u10 \
+	$(addprefix test-generate-g10-, $(GENERATORS)) \
+	test-generate-g10-counter test-generate-u10-counter \
+	test-generate-g10-inplace test-generate-u10-inplace
+
+test/out/generate-g10-%.out: test/out $(GENERATE_KERNEL)
+	./$(GENERATE_KERNEL) -g10 -G$* -n0 > $@
+
+test/out/generate-%-counter.out: test/out $(GENERATE_KERNEL)
+	./$(GENERATE_KERNEL) -$* -c -n0 > $@
+
+# Built straight from generator without edgelist, should match regular build
+test/out/generate-%-inplace.out: test/out $(GENERATE_KERNEL)
+	./$(GENERATE_KERNEL) -$* -m -n0 > $@
 
 test/out/generate-%.out: test/out $(GENERATE_KERNEL)
 	./$(GENERATE_KERNEL) -$* -n0 > $@
@@ -51,9 +67,15 @@ test-generate-%: test/out/generate-%.out
 		else echo " $(FAIL) Generates $*"; \
 	fi
 
+test-generate-%-inplace: test/out/generate-%-inplace.out
+	@if grep -q "`cat test/reference/graph-$*.out`" $<; \
+		then echo " $(PASS) Generates $* in place"; \
+		else echo " $(FAIL) Generates $* in place"; \
+	fi
+
 # Loading graphs from files
 test-load: test-load-4.gr test-load-4.el test-load-4.wel test-load-4.graph \
-					 test-load-4w.graph test-load-4.mtx test-load-4w.mtx
+					 test-load-4w.graph test-load-4.mtx test-load-4w.mtx test-load-4.sg
 
 test/out/load-%.out: test/out $(GENERATE_KERNEL)
 	./$(GENERATE_KERNEL) -f test/graphs/$* -n0 > $@
@@ -66,6 +88,101 @@ test-load-%: test/out/load-%.out
 	fi
 
 
+# Serialized graphs written by converter (with checksums) and read back
+test-serialize: test-serialize-g10 test-serialize-u10 test-serialize-truncated
+
+test/out/serialize-%.sg: test/out converter
+	./converter -$* -C -b $@ > /dev/null
+
+test/out/serialize-%.out: test/out/serialize-%.sg $(GENERATE_KERNEL)
+	./$(GENERATE_KERNEL) -f $< -n0 > $@
+
+# A cut-off file has to be refused rather than read into short buffers
+test/out/serialize-truncated.out: test/out/serialize-g10.sg $(GENERATE_KERNEL)
+	head -c 20000 $< > test/out/serialize-truncated.sg
+	./$(GENERATE_KERNEL) -f test/out/serialize-truncated.sg -n0 > $@ || true
+
+test-serialize-truncated: test/out/serialize-truncated.out
+	@if grep -q "truncated in section" $<; \
+		then echo " $(PASS) Serialize truncated"; \
+		else echo " $(FAIL) Serialize truncated"; \
+	fi
+
+.SECONDARY: # want to keep all intermediate files (test outputs)
+test-serialize-%: test/out/serialize-%.out
+	@if grep -q "`cat test/reference/graph-$*.out`" $<; \
+		then echo " $(PASS) Serialize $*"; \
+		else echo " $(FAIL) Serialize $*"; \
+	fi
+
+
+# Weighted serialized graphs of every weight type, converted when loaded
+WEIGHT_TYPES = int32 float double uint16 uint8
+WSERIALIZE_KERNEL = sssp-float
+test-wserialize: $(addprefix test-wserialize-, $(WEIGHT_TYPES)) \
+	test-wserialize-legacy test-wserialize-narrow
+
+test/out/wserialize-%.wsg: test/out converter
+	./converter -f test/graphs/4.wel -wb $@ -t $* > /dev/null
+
+test/out/wserialize-%.out: test/out/wserialize-%.wsg $(WSERIALIZE_KERNEL)
+	./$(WSERIALIZE_KERNEL) -f $< -r0 -vn1 > $@
+
+# Version 1 fixture only holds int32 weights (no header to convert from)
+test/out/wserialize-legacy.out: test/out sssp-int32
+	./sssp-int32 -f test/graphs/4.wsg -r0 -vn1 > $@
+
+# Fractional weights can't be loaded as int32, so this has to be refused
+test/out/wserialize-narrow.out: test/out converter sssp-int32
+	./converter -g10 -wb test/out/wserialize-narrow.wsg -t float -Wexp \
+		> /dev/null
+	./sssp-int32 -f test/out/wserialize-narrow.wsg -n0 > $@ || \
+		(grep -q "don't convert exactly" $@ && \
+		 echo "Verification:           PASS" >> $@) || true
+
+.SECONDARY: # want to keep all intermediate files (test outputs)
+test-wserialize-%: test/out/wserialize-%.out
+	@if grep -q "Verification:           PASS" $<; \
+		then echo " $(PASS) Serialize weights $*"; \
+		else echo " $(FAIL) Serialize weights $*"; \
+	fi
+
+
+# Weight distributions (-W), plus weights vector written by converter (-V)
+# and loaded back with -w, including through a cached permutation (-P)
+WEIGHT_DISTS = uniform exp normal powerlaw unit degree
+test-weights: $(addprefix test-weights-, $(WEIGHT_DISTS) vector perm-cache)
+
+test/out/weights-%.out: test/out sssp-float
+	./sssp-float -g10 -W$* -vn1 > $@
+
+test/out/weights-vector.out: test/out converter sssp-int32
+	./converter -g10 -wb test/out/weights-vector.wsg > /dev/null
+	./converter -g10 -V test/out/weights-vector.bin -Wexp:20 > /dev/null
+	./sssp-int32 -f test/out/weights-vector.wsg \
+		-w test/out/weights-vector.bin -vn1 > $@
+
+# a stale cache is replaced, and the rewritten one is used by the next run
+test/out/weights-perm-cache.out: test/out converter sssp-int32
+	./converter -f test/graphs/4.wel -wb test/out/perm-cache.wsg \
+		-V test/out/perm-cache.bin > /dev/null
+	head -c 512 /dev/zero > test/out/perm-cache.wsg.perm
+	./sssp-int32 -f test/out/perm-cache.wsg -w test/out/perm-cache.bin \
+		-P -vn1 > $@
+	./sssp-int32 -f test/out/perm-cache.wsg -w test/out/perm-cache.bin \
+		-P -vn1 >> $@
+	test `grep -c "Permutation Time" $@` -eq 1 || \
+		echo "Verification:           FAIL (cache not reused)" >> $@
+
+.SECONDARY:
+test-weights-%: test/out/weights-%.out
+	@if grep -q "Verification:           PASS" $< && \
+	    ! grep -q "Verification:           FAIL" $<; \
+		then echo " $(PASS) Weights $*"; \
+		else echo " $(FAIL) Weights $*"; \
+	fi
+
+
 
 # Kernel Output Verification -------------------------------------------#
 #-----------------------------------------------------------------------#
@@ -83,4 +200,75 @@ test-verify-%-$(TEST_GRAPH): test/out/verify-%-$(TEST_GRAPH).out
 		else echo " $(FAIL) Verify $*"; \
 	fi
 
-test-verify: $(addsuffix -$(TEST_GRAPH), $(addprefix test-verify-, $(KERNELS)))
+test-verify: $(addsuffix -$(TEST_GRAPH), $(addprefix test-verify-, $(KERNELS))) \
+	$(addsuffix -$(TEST_GRAPH), $(addprefix test-verify-, sssp-int32 sssp-float)) \
+	test-sssp-variants test-bfs-variants
+
+# SSSP variants selected by command-line flags (flags given without the
+# leading dash, - between flags that take arguments, and _ for :)
+SSSP_VARIANTS = L dauto dadapt H B4 T HT trandom A4 Kradix Kdelta TKdelta \
+	Kbuckets TKbuckets pwidest Kdelta-pwidest phops_3 preliable \
+	dauto-preliable Kbuckets-d0.01-Ggrid2d
+test-sssp-variants: $(addprefix test-sssp-variant-, $(SSSP_VARIANTS))
+
+# batches need several sources (last batch of 6 is partial)
+test/out/sssp-variant-B4-$(TEST_GRAPH).out: SSSP_VARIANT_ARGS = -S6
+# point-to-point queries, without and with landmarks
+test/out/sssp-variant-trandom-$(TEST_GRAPH).out: SSSP_VARIANT_ARGS = -S20
+test/out/sssp-variant-A4-$(TEST_GRAPH).out: SSSP_VARIANT_ARGS = -trandom -S20
+# reliable paths need probabilities as weights
+test/out/sssp-variant-preliable-$(TEST_GRAPH).out: SSSP_VARIANT_BIN = sssp-float
+test/out/sssp-variant-preliable-$(TEST_GRAPH).out: SSSP_VARIANT_ARGS = -Wuniform:0.5,1
+test/out/sssp-variant-dauto-preliable-$(TEST_GRAPH).out: SSSP_VARIANT_BIN = sssp-float
+test/out/sssp-variant-dauto-preliable-$(TEST_GRAPH).out: SSSP_VARIANT_ARGS = -Wuniform:0.5,1
+# priorities far past the bucket window, so it has to move along
+test/out/sssp-variant-Kbuckets-d0.01-Ggrid2d-$(TEST_GRAPH).out: SSSP_VARIANT_BIN = sssp-float
+
+SSSP_VARIANT_BIN ?= sssp-int32
+test/out/sssp-variant-%-$(TEST_GRAPH).out: test/out sssp-int32 sssp-float
+	./$(SSSP_VARIANT_BIN) -$(TEST_GRAPH) -vn1 -$(subst -, -,$(subst _,:,$*)) \
+		$(SSSP_VARIANT_ARGS) > $@
+
+.SECONDARY:
+test-sssp-variant-%: test/out/sssp-variant-%-$(TEST_GRAPH).out
+	@if grep -q "Verification:           PASS" $< && \
+	    ! grep -q "Verification:           FAIL" $<; \
+		then echo " $(PASS) Verify sssp -$*"; \
+		else echo " $(FAIL) Verify sssp -$*"; \
+	fi
+
+# BFS direction-switch parameters, given or tuned (-A auto), and outputs,
+# named like the SSSP variants
+BFS_VARIANTS = A2-B6 A1000 Aauto odepths ovisited A2-ovisited odepths-Ggrid2d
+test-bfs-variants: $(addprefix test-bfs-variant-, $(BFS_VARIANTS)) \
+	test-bfs-variant-tune-cache test-bfs-variant-tune-fixed-beta
+
+# deep enough that depths need 16 bits
+test/out/bfs-variant-odepths-Ggrid2d-$(TEST_GRAPH).out: BFS_VARIANT_ARGS = -g16
+
+test/out/bfs-variant-%-$(TEST_GRAPH).out: test/out bfs
+	./bfs -$(TEST_GRAPH) -vn1 -$(subst -, -,$(subst _,:,$*)) \
+		$(BFS_VARIANT_ARGS) > $@
+
+# a graph file gets its tuned parameters saved next to it for later runs
+test/out/bfs-variant-tune-cache-$(TEST_GRAPH).out: test/out converter bfs
+	./converter -$(TEST_GRAPH) -b test/out/bfs-tune.sg > /dev/null
+	rm -f test/out/bfs-tune.sg.dobfs
+	./bfs -f test/out/bfs-tune.sg -Aauto -n0 > /dev/null
+	./bfs -f test/out/bfs-tune.sg -Aauto -vn1 > $@
+	grep -q "Direction Params: *loaded" $@ || \
+		echo "Verification:           FAIL (params not reloaded)" >> $@
+
+# tuning keeps a beta given with -B
+test/out/bfs-variant-tune-fixed-beta-$(TEST_GRAPH).out: test/out bfs
+	./bfs -$(TEST_GRAPH) -Aauto -B6 -vn1 > $@
+	grep -q "Beta: *6$$" $@ || \
+		echo "Verification:           FAIL (beta not kept)" >> $@
+
+.SECONDARY:
+test-bfs-variant-%: test/out/bfs-variant-%-$(TEST_GRAPH).out
+	@if grep -q "Verification:           PASS" $< && \
+	    ! grep -q "Verification:           FAIL" $<; \
+		then echo " $(PASS) Verify bfs -$*"; \
+		else echo " $(FAIL) Verify bfs -$*"; \
+	fi